@@ -0,0 +1,114 @@
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file coordsOfLx.cpp
+///
+/// \brief Times the computation of the coordinates of the sites
+///
+/// The coordinates of all the sites of an hypercube are computed
+/// in sequential and random order with each UseHashedCoords mode,
+/// after checking them against the direct computation.
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <Maze.hpp>
+
+using namespace maze;
+
+/// Number of dimensions
+constexpr int nDims=4;
+
+/// Number of repetitions of the timed loop
+constexpr int N_REPETITIONS=5;
+
+DECLARE_COMPONENT(Site,int64_t,DYNAMIC,site);
+
+/// Time the computation of the coordinates of the sites listed in order, with the mode UHC
+template <UseHashedCoords UHC>
+void timeCoordsOfLx(const char* name,
+		    const Coords<nDims>& sizes,
+		    const std::vector<int64_t>& order)
+{
+  HCube<nDims,Site,UHC> hCube(sizes,Coords<nDims>::getAll(1));
+  
+  /// Number of wrong coordinates
+  int64_t nBad=0;
+  
+  for(int64_t lx=0;lx<hCube.vol;lx++)
+    {
+      /// Coordinates provided, and computed directly
+      const Coords<nDims> provided=hCube.coordsOfLx(lx);
+      const Coords<nDims> computed=hCube.computeCoordsOfLx(lx);
+      
+      for(int mu=0;mu<nDims;mu++)
+	nBad+=(provided[mu]!=computed[mu]);
+    }
+  
+  /// Combination of the coordinates, to prevent the optimization of the loop
+  int64_t sum=0;
+  
+  /// Beginning of the timing
+  const auto start=
+    std::chrono::steady_clock::now();
+  
+  for(int iRep=0;iRep<N_REPETITIONS;iRep++)
+    for(const int64_t& lx : order)
+      {
+	/// Coordinates of the site
+	const auto c=
+	  hCube.coordsOfLx(lx);
+	
+	sum+=c[0]+2*c[1]+3*c[2]+5*c[3];
+      }
+  
+  /// Time per site
+  const double nsPerSite=
+    std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-start).count()/order.size()/N_REPETITIONS;
+  
+  LOGGER<<"  "<<name<<": "<<nsPerSite<<" ns/site (checksum "<<sum<<", "<<nBad<<" wrong coordinates)"<<endl;
+}
+
+/// Time all the modes on an hypercube of the given sizes
+void timeAllModes(const Coords<nDims>& sizes)
+{
+  /// Volume of the hypercube
+  const int64_t vol=
+    sizes.prodAll();
+  
+  /// Sites in sequential and random order
+  std::vector<int64_t> sequential(vol);
+  std::iota(sequential.begin(),sequential.end(),0);
+  std::vector<int64_t> random=sequential;
+  std::shuffle(random.begin(),random.end(),std::mt19937_64(3));
+  
+  for(const auto& [orderName,order] : {std::make_pair("sequential",&sequential),std::make_pair("random",&random)})
+    {
+      LOGGER<<sizes[0]<<"x"<<sizes[1]<<"x"<<sizes[2]<<"x"<<sizes[3]<<" "<<orderName<<", tables of "<<vol*sizeof(Coords<nDims>)/1e6<<" MB hashed, "<<vol*sizeof(uint32_t)/1e6<<" MB packed"<<endl;
+      
+      timeCoordsOfLx<NOT_HASHED>("NOT_HASHED",sizes,*order);
+      timeCoordsOfLx<HASHED>("HASHED",sizes,*order);
+      timeCoordsOfLx<FAST_DIVIDE>("FAST_DIVIDE",sizes,*order);
+      timeCoordsOfLx<HASHED_PACKED>("HASHED_PACKED",sizes,*order);
+    }
+}
+
+void inMain(int narg,char** arg)
+{
+  timeAllModes({24,24,24,48});
+  timeAllModes({7,13,11,5});
+  timeAllModes({48,48,48,96});
+}
+
+int main(int narg,char** arg)
+{
+  initMaze(inMain,narg,arg);
+  
+  finalizeMaze();
+  
+  return 0;
+}
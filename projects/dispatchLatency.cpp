@@ -0,0 +1,125 @@
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file dispatchLatency.cpp
+///
+/// \brief Times the dispatch of work to the thread pool
+///
+/// Many parallel sections, each doing almost nothing, are opened in
+/// a row, passing either an empty closure or a small one, capturing
+/// some values by copy. The time per dispatch measures the overhead
+/// of the pool. The number of dispatches can be passed as argument.
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+#include <Maze.hpp>
+
+using namespace maze;
+
+/// Default number of dispatches
+constexpr int64_t DEFAULT_N_DISPATCHES=200000;
+
+/// Number of values captured by the small closure
+constexpr int N_CAPTURED_VALUES=12;
+
+/// Time nDispatches calls of f, returning the time per call in ns
+template <typename F>
+double nsPerDispatch(const int64_t& nDispatches,
+		     const F& f)
+{
+  /// Beginning of the timing
+  const auto start=
+    std::chrono::steady_clock::now();
+  
+  for(int64_t i=0;i<nDispatches;i++)
+    f();
+  
+  return
+    std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-start).count()/nDispatches;
+}
+
+void inMain(int narg,char** arg)
+{
+  /// Number of dispatches
+  const int64_t nDispatches=
+    (narg>1)?atoll(arg[1]):DEFAULT_N_DISPATCHES;
+  
+  /// Number of threads sharing the work
+  const int nUsedThreads=
+#ifdef USE_THREADS
+    nThreads
+#else
+    1
+#endif
+    ;
+  
+  /// Values captured by the small closure
+  std::array<int64_t,N_CAPTURED_VALUES> values;
+  for(int i=0;i<N_CAPTURED_VALUES;i++)
+    values[i]=i+1;
+  
+  /// Result of each thread, written by the small closure
+  std::vector<int64_t> results(nUsedThreads,0);
+  
+  /// Pointer to the results, to be captured
+  int64_t* res=
+    results.data();
+  
+  LOGGER<<nDispatches<<" dispatches on "<<nUsedThreads<<" threads, small closure of "<<sizeof(values)+sizeof(res)<<" bytes"<<endl;
+
+#ifdef USE_THREADS
+  LOGGER<<"  parallel, empty closure: "<<
+    nsPerDispatch(nDispatches,[]()
+			      {
+				ThreadPool::parallel([](const int&)
+						     {
+						     });
+			      })<<" ns/dispatch"<<endl;
+  
+  LOGGER<<"  parallel, small closure: "<<
+    nsPerDispatch(nDispatches,[&values,res]()
+			      {
+				ThreadPool::parallel([values,res](const int& threadId)
+						     {
+						       res[threadId]+=values[threadId%N_CAPTURED_VALUES];
+						     });
+			      })<<" ns/dispatch"<<endl;
+#endif
+  
+  LOGGER<<"  loopSplit, empty closure: "<<
+    nsPerDispatch(nDispatches,[nUsedThreads]()
+			      {
+				ThreadPool::loopSplit((int64_t)0,(int64_t)nUsedThreads,[](const int64_t&)
+						  {
+						  },ThreadPool::STATIC);
+			      })<<" ns/dispatch"<<endl;
+  
+  LOGGER<<"  loopSplit, small closure: "<<
+    nsPerDispatch(nDispatches,[nUsedThreads,&values,res]()
+			      {
+				ThreadPool::loopSplit((int64_t)0,(int64_t)nUsedThreads,[values,res](const int64_t& i)
+						  {
+						    res[i]+=values[i%N_CAPTURED_VALUES];
+						  },ThreadPool::STATIC);
+			      })<<" ns/dispatch"<<endl;
+  
+  /// Sum of the results, to prevent the optimization of the closures
+  int64_t sum=0;
+  for(const int64_t& r : results)
+    sum+=r;
+  
+  LOGGER<<"Checksum: "<<sum<<endl;
+}
+
+int main(int narg,char** arg)
+{
+  initMaze(inMain,narg,arg);
+  
+  finalizeMaze();
+  
+  return 0;
+}
@@ -0,0 +1,211 @@
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file hilbertOrdering.cpp
+///
+/// \brief Compares the locality of the lx, Lebesgue and Hilbert orderings
+///
+/// For each site, taken in storage order, the data of all the
+/// neighbours is read. The accesses are passed to a simulated
+/// 8-way LRU cache hierarchy, made of a 32 KiB L1 and a 256 KiB L2,
+/// and the misses per site are reported. The Hilbert ordering is
+/// also checked to be consistent in both directions and to step
+/// between nearest neighbours.
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <Maze.hpp>
+
+using namespace maze;
+
+/// Number of dimensions
+constexpr int nDims=4;
+
+/// Size of the cache lines
+constexpr int64_t CACHE_LINE_SIZE=64;
+
+DECLARE_COMPONENT(LebSite,int64_t,DYNAMIC,lebSite);
+
+DECLARE_COMPONENT(HilSite,int64_t,DYNAMIC,hilSite);
+
+/// Simulated set-associative cache with LRU replacement
+struct SimulatedCache
+{
+  /// Number of ways of each set
+  const int64_t nWays;
+  
+  /// Lines held by each set, from the most recently used
+  std::vector<std::vector<int64_t>> sets;
+  
+  /// Number of misses
+  int64_t nMisses{0};
+  
+  /// Creates the cache of the given size and number of ways
+  SimulatedCache(const int64_t& size,
+		 const int64_t& nWays) :
+    nWays(nWays),
+    sets(size/CACHE_LINE_SIZE/nWays)
+  {
+  }
+  
+  /// Access the line at addr, returning whether it missed
+  bool access(const int64_t& addr)
+  {
+    /// Line accessed
+    const int64_t line=
+      addr/CACHE_LINE_SIZE;
+    
+    /// Set where the line is stored
+    std::vector<int64_t>& set=
+      sets[line%(int64_t)sets.size()];
+    
+    /// Position of the line in the set
+    const auto pos=
+      std::find(set.begin(),set.end(),line);
+    
+    /// Determine whether the line is missing
+    const bool miss=
+      (pos==set.end());
+    
+    if(miss)
+      {
+	nMisses++;
+	if((int64_t)set.size()==nWays)
+	  set.pop_back();
+      }
+    else
+      set.erase(pos);
+    
+    set.insert(set.begin(),line);
+    
+    return miss;
+  }
+};
+
+/// Simulate the gather of the neighbours in the ordering given by posOfLx and lxOfPos
+template <typename G,
+	  typename PosOfLx,
+	  typename LxOfPos>
+void simulateGather(const char* name,
+		    const G& geometry,
+		    const PosOfLx& posOfLx,
+		    const LxOfPos& lxOfPos,
+		    const int64_t& bytesPerSite)
+{
+  /// First and second level of cache
+  SimulatedCache l1(32<<10,8),l2(256<<10,8);
+  
+  for(int64_t pos=0;pos<geometry.locVol;pos++)
+    {
+      /// Site at the position
+      const int64_t lx=
+	lxOfPos(pos);
+      
+      for(int dir=0;dir<2*nDims;dir++)
+	{
+	  /// Beginning of the data of the neighbour
+	  const int64_t beg=
+	    posOfLx(geometry.locGrid.neighOfLx(lx,dir))*bytesPerSite;
+	  
+	  // The second level sees only the misses of the first
+	  for(int64_t addr=beg/CACHE_LINE_SIZE*CACHE_LINE_SIZE;addr<beg+bytesPerSite;addr+=CACHE_LINE_SIZE)
+	    if(l1.access(addr))
+	      l2.access(addr);
+	}
+    }
+  
+  LOGGER<<"  "<<name<<": L1 misses/site "<<(double)l1.nMisses/geometry.locVol<<", L2 misses/site "<<(double)l2.nMisses/geometry.locVol<<endl;
+}
+
+/// Compare the orderings on a lattice of the given sizes
+void compareOrderings(const Coords<nDims>& sizes,
+		      const int64_t& bytesPerSite)
+{
+  Geometry<nDims> geometry(sizes,Coords<nDims>::getAll(1));
+  geometry.locGrid.initNeighsTable();
+  
+  /// Lebesgue ordering
+  const auto leb=
+    getLebesgueIndexer<LebSite>(geometry.locGrid);
+  
+  /// Beginning of the construction of the Hilbert ordering
+  const auto start=
+    std::chrono::steady_clock::now();
+  
+  /// Hilbert ordering
+  const auto hil=
+    getHilbertIndexer<HilSite>(geometry.locGrid);
+  
+  /// Time needed to build the Hilbert ordering
+  const double buildTime=
+    std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+  
+  /// Lx of the point of the Hilbert curve
+  auto lxOfHil=
+    [&hil](const int64_t& h) -> int64_t
+    {
+      return std::get<0>(hil.lxOfId(TensorComps<HilSite>{h}));
+    };
+  
+  /// Point of the Hilbert curve of the lx
+  auto hilOfLx=
+    [&hil](const int64_t& lx) -> int64_t
+    {
+      return std::get<0>(hil.idOfLx(TensorComps<typename Geometry<nDims>::LocSite>{lx}));
+    };
+  
+  /// Number of inconsistent lookups, and of steps between non-neighbours
+  int64_t nBad=0,nNonAdjacent=0;
+  
+  for(int64_t h=0;h<geometry.locVol;h++)
+    {
+      nBad+=(hilOfLx(lxOfHil(h))!=h);
+      
+      if(h)
+	{
+	  /// Coordinates of the current and previous point
+	  const Coords<nDims> cur=geometry.locCoordsOfLocLx(lxOfHil(h));
+	  const Coords<nDims> prev=geometry.locCoordsOfLocLx(lxOfHil(h-1));
+	  
+	  /// Distance between the points
+	  int dist=0;
+	  for(int mu=0;mu<nDims;mu++)
+	    dist+=abs(cur[mu]-prev[mu]);
+	  
+	  nNonAdjacent+=(dist!=1);
+	}
+    }
+  
+  LOGGER<<sizes[0]<<"x"<<sizes[1]<<"x"<<sizes[2]<<"x"<<sizes[3]<<", "<<bytesPerSite<<" bytes/site: Hilbert built in "<<buildTime<<" ms, "<<nBad<<" inconsistent lookups, "<<nNonAdjacent<<" steps between non-neighbours"<<endl;
+  
+  simulateGather("lx",geometry,
+		 [](const int64_t& lx){return lx;},
+		 [](const int64_t& pos){return pos;},bytesPerSite);
+  simulateGather("Lebesgue",geometry,
+		 [&leb](const int64_t& lx) -> int64_t {return std::get<0>(leb.idOfLx(TensorComps<typename Geometry<nDims>::LocSite>{lx}));},
+		 [&leb](const int64_t& pos) -> int64_t {return std::get<0>(leb.lxOfId(TensorComps<LebSite>{pos}));},bytesPerSite);
+  simulateGather("Hilbert",geometry,hilOfLx,lxOfHil,bytesPerSite);
+}
+
+void inMain(int narg,char** arg)
+{
+  /// Size of the data of each site, a spincolor of complex doubles
+  const int64_t bytesPerSite=
+    192;
+  
+  compareOrderings({16,16,16,16},bytesPerSite);
+  compareOrderings({24,20,12,18},bytesPerSite);
+  compareOrderings({12,10,14,6},bytesPerSite);
+}
+
+int main(int narg,char** arg)
+{
+  initMaze(inMain,narg,arg);
+  
+  finalizeMaze();
+  
+  return 0;
+}
@@ -37,183 +37,15 @@ struct SitesOrdering<Lx,TensorComps<C...>>
   }
 };
 
-DECLARE_COMPONENT(EosSite,int64_t,DYNAMIC,eosSite);
 DECLARE_COMPONENT(LebSite,int64_t,DYNAMIC,lebSite);
 
-DECLARE_COMPONENT(BlockId,int64_t,DYNAMIC,blockId);
 DECLARE_COMPONENT(BlockedSite,int64_t,DYNAMIC,blockedSite);
-DECLARE_COMPONENT(BlockedEosSite,int64_t,DYNAMIC,blockedEosSite);
 
 
 
-// /// Initializer for a even/odd split index
-// template <typename G>
-// struct EosIndexInitializer
-// {
-//   /// Reference geometry
-//   const G& geo;
-  
-//   static constexpr int nDims=
-//     G::nDims;
-  
-//   using Direction=
-//     typename G::Direction;
-  
-//   /// Even/Odd split dimension
-//   const Direction eoSplitDimension;
-  
-//   using LocSite=
-//     typename G::LocSite;
-  
-//   using Parity=
-//     typename G::Parity;
-  
-//   using ParityHCube=
-//     HCube<nDims,Parity,NOT_HASHED>;
-  
-//   ParityHCube parityHCube;
-  
-//   /// Sizes of the even/odd split sites
-//   const Coords<nDims> locEoSizes;
-  
-//   /// Even/Odd split hypercube grouping two sites
-//   const HCube<nDims,EosSite,UseHashedCoords::HASHED> eosHCube;
-  
-//   /// Constructor
-//   EosIndexInitializer(const Geometry<nDims>& geo,
-// 		      const Direction& eoSplitDimension) :
-//     geo(geo),
-//     eoSplitDimension(eoSplitDimension),
-//     parityHCube(Coords<nDims>::versor(eoSplitDimension)+
-// 		Coords<nDims>::getAll(1),allDimensions<nDims>),
-//     locEoSizes(geo.locSizes/parityHCube.sizes),
-//     eosHCube(locEoSizes,geo.isDirectionFullyLocal)
-//   {
-//     LOGGER<<"e/o split dimension: "<<eoSplitDimension<<endl;
-//     LOGGER<<"loceo sizes: "<<locEoSizes<<endl;
-//   }
-  
-//   /// Computes the two local sites of a given eosSite
-//   std::array<LocSite,2> locLxPairOfEosSite(const EosSite& eosSite) const
-//   {
-//       /// Coordinates in the eos hypercube
-//       const Coords<nDims> eosCoords=
-// 	eosHCube.coordsOfLx(eosSite);
-      
-//       /// Result
-//       std::array<LocSite,2> out;
-      
-//       for(int i=0;i<2;i++)
-// 	{
-// 	  /// Coordinates
-// 	  Coords<nDims> lxCoords=
-// 	    eosCoords;
-	  
-// 	  // Double in the eo dimension and increase in turn
-// 	  lxCoords[eoSplitDimension]=
-// 	    2*lxCoords[eoSplitDimension]+i;
-	  
-// 	  /// Local site
-// 	  const LocSite locLx=
-// 	    geo.computeLxOfLocCoords(lxCoords);
-	  
-// 	  /// Parity of the site
-// 	  const Parity par=
-// 	    geo.parityOfLocLx(locLx);
-	  
-// 	  out[par]=locLx;
-// 	}
-      
-//       return out;
-//     }
-//  };
-  
 // rank,eo,block,blocked
 
 
-// /// Geometry for fused sites
-// template <int NDim>
-// struct FusedSitesGeometry
-// {
-//   ///  Reference geometry
-//   using Geom=Geometry<NDim>;
-  
-//   /// Type used to refer to virtual nodes
-//   using VNodesIndex=
-//     typename Geom::ShortIndex;
-  
-//   // Type used to refer to fused sites
-//   using FSitesIndex=
-//     typename Geom::LongIndex;
-  
-//   /// Type used to refer to local index
-//   using LocLxIndex=
-//     typename Geom::LongIndex;
-  
-//   /// Virtual nodes hypercube
-//   using VNodesHCube=
-//     HCube<NDim,VNodesIndex>;
-  
-//   /// Fused sites hypercube
-//   using FSitesHCube=
-//     HCube<NDim,FSitesIndex>;
-  
-//   /// Reference geometry
-//   const Geometry<NDim>& geom;
-  
-//   /// Hypercube to access virtual nodes
-//   const VNodesHCube vNodesHCube;
-  
-//   /// Hypercube to move within fused sites
-//   const FSitesHCube fSitesHCube;
-  
-//   /// Lebesgue ordering of fused sites
-//   const IndexedHypercube<NDim,FSitesIndex> LebOrder;
-  
-//   /// Computes the coords of a given fused site
-//   const Coords<NDim>& computeFSiteCoordsOfLeb(const FSitesIndex& fSiteLeb) const
-//   {
-//     /// Computes the lx order
-//     FSitesIndex& fSiteLx=
-//       LebOrder.lxOfId[fSiteLeb];
-    
-//     return
-//       fSitesHCube.coordsOfLx[fSiteLx];
-//   }
-  
-//   /// Compute global lx of a given pair of fused/unfused indices
-//   Coords<NDim> computeLocCoordsfFSiteVNode(const VNodesIndex& vNode,
-// 					   const FSitesIndex& fSiteLeb) const
-//   {
-//     /// Fused site coordinates
-//     const Coords<NDim> fSiteCoords=
-//       computeFSiteCoords(fSiteLeb);
-    
-//     /// Virtual node coordinates
-//     const Coords<NDim> vNodeCoords=
-//       vNodesHCube.coordsOfLx[vNode];
-    
-//     /// Local coordinates
-//     const Coords<NDim> locCoords=
-//       vNodeCoords+vNodesHCube.sizes*fSiteCoords;
-    
-//     return locCoords;
-//   }
-  
-//   /// Constructor
-//   FusedSitesGeometry(const Geometry<NDim>& geom,
-// 		     const Coords<NDim>& vNodesLxSizes) :
-//     geom(geom),
-//     vNodesHCube(vNodesLxSizes),
-//     fSitesHCube(geom.locHCube.sizes/vNodesLxSizes),
-//     LebOrder(fSitesHCube,LxOfLebesgueCalculator<NDim,FSitesIndex>(fSitesHCube),HowToIndex::DEDUCE_LX_FROM_INDEX)
-//   {
-//     if((geom.locHCube.sizes%vNodesLxSizes).sumAll())
-//       CRASHER<<"Local sizes "<<geom.locHCube.sizes<<" incompatible with requested vNodes Sizes"<<vNodesLxSizes<<endl;
-//   }
-// };
-
-
   // /// Structure to compute Lebesgue index
   // template <typename HC,
   // 	    typename Index>
@@ -291,77 +123,27 @@ void inMain(int narg,char** arg)
   testa=test;
   LOGGER<<"ANNA2 post"<<testa[geometry.parity(0)]<<endl;
   
-  /// Sizes of the block
-  const Coords<nDims> nBlockedSitesPerDir=
-    {2,2,3,3};
+  // Assign an expression of scalars, without components, to all the elements
+  testa=ScalarExpr<double>(1.0)+ScalarExpr<double>(2.0);
+  for(Parity par=0;par<2;par++)
+    if(testa[par]!=3.0)
+      CRASHER<<"Assigning a sum of scalars gave "<<testa[par]<<" at parity "<<par<<", expected 3"<<endl;
   
-  //EosIndexInitializer<Geometry<nDims>> eosIndexInitializer(geometry,nBlockedSitesPerDir.fastestLocalEvenDimension());
-  //LOGGER<<"Parity hypercube: "<<eosIndexInitializer.parityHCube.sizes<<endl;
-  
-  /// Compute the parity
-  auto parityHCube=
-    geometry.getParityGrid(nBlockedSitesPerDir.fastestLocalEvenDimension());
-  
-  /// Size of the parity hypercube
-  const auto& paritySizes=
-    parityHCube.sizes;
-  
-  /// Number of blocks in each direction
-  const Coords<nDims> nBlocksPerDir=
-    geometry.locSizes/nBlockedSitesPerDir;
-  
-  /// Sizes of the e/o block
-  const Coords<nDims> nEosBlockedSitesPerDir=
-    nBlockedSitesPerDir/paritySizes;
-  
-  /// Blocks hypercube
-  HCube<nDims,BlockId,HASHED> blocksHCube(nBlocksPerDir,{1,1,1,1});
-  
-  /// Blocked e/o sites hypercube
-  HCube<nDims,BlockedEosSite,HASHED> blockedEosSitesHCube(nEosBlockedSitesPerDir,{1,1,1,1});
-  
-  //const BlockedId eoBlockedSize=geometry.locVol/bCube.vol/2;
-  //Tensor<EoBlockedComps> blocked(bCube.vol,eoBlockedSize);
+  /// Blocked ordering of the local sites
+  const BlockedGeometry<Geometry<nDims>> blockedGeometry(geometry,Coords<nDims>{2,2,3,3});
   
   LOGGER<<"Local size: "<<geometry.locSizes<<" , "<<geometry.locVol<<" sites"<<endl;
-  LOGGER<<"N blocks per dir: "<<nBlocksPerDir<<" , "<<blocksHCube.vol<<" blocks"<<endl;
-  LOGGER<<"Blocked eos sites sizes: "<<nEosBlockedSitesPerDir<<endl;
+  LOGGER<<"N blocks per dir: "<<blockedGeometry.blocksGrid.sizes<<" , "<<blockedGeometry.blocksGrid.vol<<" blocks"<<endl;
+  LOGGER<<"Blocked eos sites sizes: "<<blockedGeometry.blockedEosGrid.sizes<<endl;
+  LOGGER<<"Block sizes fitting half the L2 cache with 1 KiB per site: "<<
+    BlockedGeometry<Geometry<nDims>>::computeBlockSizes(geometry.locSizes,1024)<<endl;
   
   for(LocSite locSite=0;locSite<geometry.locVol;locSite++)
     {
-      /// Parity
-      const Parity par=
-	geometry.parityOfLocLx(locSite);
-      
-      /// Coordinates of the site
-      const Coords<nDims> locSiteCoords=
-	geometry.locCoordsOfLocLx(locSite);
-      
-      /// Coordinateds of the block
-      const Coords<nDims> blockCoords=
-	locSiteCoords/nBlockedSitesPerDir;
-      
-      /// Coordinates inside the block
-      const Coords<nDims> blockedCoords=
-	locSiteCoords%nBlockedSitesPerDir;
-      
-      /// Coordinates inside the blocked e/o hypercube
-      const Coords<nDims> blockedEosCoords=
-	blockedCoords/paritySizes;
-      
-      /// Id inside the block
-      const BlockId blockId=
-	blocksHCube.computeLxOfCoords(blockCoords);
-      
-      /// Id inside the blocked e/o hypercube
-      const BlockedEosSite blockedEosSite=
-	blockedEosSitesHCube.computeLxOfCoords(blockedEosCoords);
-      
-      LOGGER<<" Lx "<<locSite<<" "<<locSiteCoords<<" , par: "<<par<<" , block: "<<blockId<<" "<<blockCoords<<" , id: "<<blockedEosSite<<" "<<blockedEosCoords<<endl;
-      //loc_site <--- eo,eosSite
-      //loc_site <--- block,blockedSite
+      const auto& [par,blockId,blockedEosSite]=
+	blockedGeometry.blockedOfLx(locSite);
       
-      // loc_site <--- eo,block,blockedEoSite
+      LOGGER<<" Lx "<<locSite<<" "<<geometry.locCoordsOfLocLx(locSite)<<" , par: "<<par<<" , block: "<<blockId<<" , id: "<<blockedEosSite<<endl;
     }
   
   /* la cosa meglio sarebbe far si' che il site shuffler prendesse
@@ -389,7 +171,7 @@ void inMain(int narg,char** arg)
   
   /////////////////////////////////////////////////////////////////
   
-  const EosSite locVolh(geometry.locVolH);
+  const Geometry<nDims>::EosSite locVolh(geometry.locVolH);
   
   LOGGER<<"/////////////////////////////////////////////////////////////////"<<endl;
 
@@ -5,6 +5,8 @@
 ///
 /// \brief Topical headr for all expressions
 
+#include <expr/binaryExpr.hpp>
 #include <expr/expr.hpp>
+#include <expr/scalar.hpp>
 
 #endif
@@ -0,0 +1,16 @@
+#ifndef _IO_HPP
+#define _IO_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file IO.hpp
+///
+/// \brief Include all headers for input/output
+
+#include <io/checkpoint.hpp>
+#include <io/file.hpp>
+#include <io/tensorIO.hpp>
+
+#endif
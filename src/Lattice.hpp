@@ -1,10 +1,15 @@
 #ifndef _LATTICE_HPP
 #define _LATTICE_HPP
 
+#include <lattice/blockedGeometry.hpp>
 #include <lattice/coords.hpp>
+#include <lattice/eosLayout.hpp>
+#include <lattice/fusedSitesGeometry.hpp>
 #include <lattice/geometry.hpp>
+#include <lattice/halo.hpp>
 #include <lattice/hCube.hpp>
 #include <lattice/hCubeIndexer.hpp>
+#include <lattice/Hilbert.hpp>
 #include <lattice/indexShuffler.hpp>
 #include <lattice/Lebesgue.hpp>
 #include <lattice/lxCoordsProvider.hpp>
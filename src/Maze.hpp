@@ -12,6 +12,7 @@
 #include <Base.hpp>
 #include <Debug.hpp>
 #include <Expr.hpp>
+#include <IO.hpp>
 #include <Lattice.hpp>
 #include <MetaProgramming.hpp>
 #include <Resources.hpp>
@@ -9,8 +9,10 @@
 ///
 /// \brief Include all headers for resources
 
+#include <resources/cacheSizes.hpp>
 #include <resources/environmentFlags.hpp>
 #include <resources/memoryManager.hpp>
+#include <resources/parallelCopy.hpp>
 #include <resources/storLoc.hpp>
 #include <resources/vector.hpp>
 
@@ -14,6 +14,7 @@
 #include <tensors/componentsList.hpp>
 #include <tensors/componentSize.hpp>
 #include <tensors/loopOnAllComponentsValues.hpp>
+#include <tensors/mergedComp.hpp>
 #include <tensors/tensor.hpp>
 #include <tensors/tensorDecl.hpp>
 #include <tensors/tensorSlice.hpp>
@@ -10,6 +10,9 @@
 #endif
 
 #include <threads/kernel.hpp>
+#include <threads/futex.hpp>
 #include <threads/pool.hpp>
+#include <threads/reduce.hpp>
+#include <threads/spinLock.hpp>
 
 #endif
@@ -7,6 +7,7 @@
 
 /// \file Utilities.hpp
 
+#include <utilities/crc32c.hpp>
 #include <utilities/factorize.hpp>
 #include <utilities/math.hpp>
 #include <utilities/tuple.hpp>
@@ -9,7 +9,9 @@
 ///
 /// MPI parallelization
 
+#include <cstdint>
 #include <mpi.h>
+#include <type_traits>
 
 #include <tensors/component.hpp>
 
@@ -84,6 +86,80 @@ namespace maze
   /// Barrier
   void ranksBarrier();
   
+#ifdef USE_MPI
+  
+  /// MPI datatype corresponding to T
+  template <typename T>
+  MPI_Datatype mpiDatatypeOf()
+  {
+    if constexpr(std::is_same_v<T,double>)
+      return MPI_DOUBLE;
+    else if constexpr(std::is_same_v<T,float>)
+      return MPI_FLOAT;
+    else if constexpr(std::is_same_v<T,int32_t>)
+      return MPI_INT32_T;
+    else if constexpr(std::is_same_v<T,int64_t>)
+      return MPI_INT64_T;
+    else if constexpr(std::is_same_v<T,uint64_t>)
+      return MPI_UINT64_T;
+    else
+      static_assert(std::is_void_v<T>,"MPI datatype not known");
+  }
+
+#endif
+  
+  /// Combine the value of all ranks with the MPI operation op
+  ///
+  /// Without MPI, the value is returned
+  template <typename T>
+  T ranksAllReduce(const T& in,
+		   [[ maybe_unused ]] const MPI_Op& op)
+  {
+#ifdef USE_MPI
+    /// Result
+    T out;
+    
+    MPI_Allreduce(&in,&out,1,mpiDatatypeOf<T>(),op,MPI_COMM_WORLD);
+    
+    return out;
+#else
+    return in;
+#endif
+  }
+  
+  /// Sum the value among all ranks
+  template <typename T>
+  T ranksAllReduceSum(const T& in)
+  {
+    return ranksAllReduce(in,MPI_SUM);
+  }
+  
+  /// Take the maximum of the value among all ranks
+  template <typename T>
+  T ranksAllReduceMax(const T& in)
+  {
+    return ranksAllReduce(in,MPI_MAX);
+  }
+  
+  /// Sum the value of all the ranks preceding the current one
+  ///
+  /// The result is zero on the first rank, and without MPI
+  template <typename T>
+  T ranksExclusiveScanSum([[ maybe_unused ]] const T& in)
+  {
+    /// Result
+    T out=0;
+    
+#ifdef USE_MPI
+    MPI_Exscan(&in,&out,1,mpiDatatypeOf<T>(),MPI_SUM,MPI_COMM_WORLD);
+    
+    // The result is undefined on the first rank
+    if(isMasterRank())
+      out=0;
+#endif
+    
+    return out;
+  }
 }
 
 #undef EXTERN_RANK
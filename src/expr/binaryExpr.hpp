@@ -0,0 +1,319 @@
+#ifndef _BINARY_EXPR_HPP
+#define _BINARY_EXPR_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file expr/binaryExpr.hpp
+///
+/// \brief Lazy binary operations between expressions
+///
+/// The operators +, - and * between two expressions do not evaluate
+/// anything, but return a node holding the two operands. The node is
+/// evaluated element by element only when assigned, so that
+/// a=b+c*d is computed in a single loop without temporaries.
+///
+/// The components of the node are the union of those of the
+/// operands: each operand is broadcast over the components it does
+/// not have. Products are therefore element-wise, no contraction is
+/// performed.
+
+#include <type_traits>
+
+#include <expr/expr.hpp>
+#include <expr/scalar.hpp>
+#include <utilities/tuple.hpp>
+
+namespace maze
+{
+  /// Sum of two operands
+  struct SumOp
+  {
+    /// Computes the operation
+    template <typename X,
+	      typename Y>
+    CUDA_HOST_DEVICE INLINE_FUNCTION
+    static auto compute(const X& x,
+			const Y& y)
+    {
+      return
+	x+y;
+    }
+  };
+  
+  /// Difference of two operands
+  struct SubtOp
+  {
+    /// Computes the operation
+    template <typename X,
+	      typename Y>
+    CUDA_HOST_DEVICE INLINE_FUNCTION
+    static auto compute(const X& x,
+			const Y& y)
+    {
+      return
+	x-y;
+    }
+  };
+  
+  /// Product of two operands
+  struct ProdOp
+  {
+    /// Computes the operation
+    template <typename X,
+	      typename Y>
+    CUDA_HOST_DEVICE INLINE_FUNCTION
+    static auto compute(const X& x,
+			const Y& y)
+    {
+      return
+	x*y;
+    }
+  };
+  
+  /// Type used to store an operand in an expression
+  ///
+  /// Operands asking to be taken by reference (such as tensors) are
+  /// referred, the others are copied
+  template <typename E>
+  using ExprRefOrVal=
+    std::conditional_t<E::takeAsArgByRef,const E&,E>;
+  
+  namespace impl
+  {
+    /// Components of a binary expression
+    ///
+    /// Those of the first operand, followed by those present only in the second
+    template <typename AC,
+	      typename BC>
+    using BinaryExprComps=
+      TupleCat<AC,TupleFilterOut<AC,BC>>;
+  }
+  
+  /// Binary expression
+  ///
+  /// The operands are stored as _A and _B, which can be references or values
+  template <typename Op,
+	    typename _A,
+	    typename _B>
+  struct BinaryExpr :
+    Expr<BinaryExpr<Op,_A,_B>,
+	 impl::BinaryExprComps<typename std::decay_t<_A>::Comps,typename std::decay_t<_B>::Comps>>
+  {
+    /// First operand type
+    using A=
+      std::decay_t<_A>;
+    
+    /// Second operand type
+    using B=
+      std::decay_t<_B>;
+    
+    /// Expression is copied when taken as argument in expression
+    static constexpr bool takeAsArgByRef=
+      false;
+    
+    /// Expression cannot be assigned
+    static constexpr bool canBeAssigned=
+      false;
+    
+    /// An expression has no data to loop on
+    static constexpr bool loopIndexIsDataOffset=
+      false;
+    
+    /// Components
+    using Comps=
+      impl::BinaryExprComps<typename A::Comps,typename B::Comps>;
+    
+    /// Type to be used for the index
+    using Index=
+      std::common_type_t<typename A::Index,typename B::Index>;
+    
+    /// Fundamental type
+    using Fund=
+      std::decay_t<decltype(Op::compute(std::declval<const typename A::Fund&>(),
+					std::declval<const typename B::Fund&>()))>;
+    
+    /// First operand
+    ///
+    /// Not const, so that moving the node moves the operand
+    _A a;
+    
+    /// Second operand
+    _B b;
+    
+    /// Size of the component C, taken from the operand which has it
+    template <typename C>
+    CUDA_HOST_DEVICE INLINE_FUNCTION
+    decltype(auto) compSize()
+      const
+    {
+      if constexpr(TupleHasType<C,typename A::Comps>)
+	return
+	  a.template compSize<C>();
+      else
+	return
+	  b.template compSize<C>();
+    }
+    
+    /// Evaluate the operation on the passed components
+    template <typename...C>
+    CUDA_HOST_DEVICE INLINE_FUNCTION
+    Fund eval(const TensorComps<C...>& c)
+      const
+    {
+      return
+	Op::compute(a.eval(c),b.eval(c));
+    }
+    
+    /// Determine whether both the operands are laid out as a tensor with components Cs
+    template <typename Cs>
+    static constexpr bool isLaidOutAs=
+      A::template isLaidOutAs<Cs> and
+      B::template isLaidOutAs<Cs>;
+    
+    /// Evaluate the operation at the given position of the data of the operands
+    ///
+    /// Can be used only if both operands are laid out in the same way
+    template <typename I>
+    CUDA_HOST_DEVICE INLINE_FUNCTION
+    Fund trivialAccess(const I& i)
+      const
+    {
+      return
+	Op::compute(a.trivialAccess(i),b.trivialAccess(i));
+    }
+    
+    /// Component absorbed into simd, void if none of the operands constrains it
+    using SimdComp=
+      std::conditional_t<std::is_void_v<typename A::SimdComp>,
+			 typename B::SimdComp,
+			 typename A::SimdComp>;
+    
+    /// The expression can be simdified if both operands can, on the same component
+    static constexpr bool canBeSimdified=
+      A::canBeSimdified and
+      B::canBeSimdified and
+      (std::is_void_v<typename A::SimdComp> or
+       std::is_void_v<typename B::SimdComp> or
+       std::is_same_v<typename A::SimdComp,typename B::SimdComp>);
+    
+    /// Returns the same expression on the simdified operands
+    template <bool C=canBeSimdified,
+	      ENABLE_THIS_TEMPLATE_IF(C)>
+    auto simdify()
+      const
+    {
+      return
+	BinaryExpr<Op,decltype(a.simdify()),decltype(b.simdify())>(a.simdify(),b.simdify());
+    }
+    
+    /// Bind the components of b present in the operand e
+    ///
+    /// The operand is returned as it is if it has none of them
+    template <typename E,
+	      typename...C>
+    CUDA_HOST_DEVICE INLINE_FUNCTION
+    static decltype(auto) bindOperand(const E& e,
+				      const TensorComps<C...>& c)
+    {
+      /// Components to be bound in the operand
+      using BoundComps=
+	TupleCommonTypes<typename E::Comps,TensorComps<C...>>;
+      
+      if constexpr(std::tuple_size_v<BoundComps> ==0)
+	return
+	  ExprRefOrVal<E>(e);
+      else
+	return
+	  e.bind(tupleGetSubset<BoundComps>(c));
+    }
+    
+    /// Returns the same expression on the bound operands
+    template <typename...C>
+    CUDA_HOST_DEVICE INLINE_FUNCTION
+    auto bind(const TensorComps<C...>& c)
+      const
+    {
+      return
+	BinaryExpr<Op,decltype(bindOperand(a,c)),decltype(bindOperand(b,c))>(bindOperand(a,c),bindOperand(b,c));
+    }
+    
+    /// Construct from the operands
+    template <typename EA,
+	      typename EB>
+    CUDA_HOST_DEVICE
+    BinaryExpr(EA&& a,
+	       EB&& b) :
+      a(std::forward<EA>(a)),
+      b(std::forward<EB>(b))
+    {
+    }
+  };
+  
+  /// Provides a binary operator OP between two expressions, computed by OP_NAME
+#define PROVIDE_BINARY_OPERATOR(OP,OP_NAME)				\
+  /*! Lazy OP between two expressions */				\
+  template <typename A,							\
+	    typename AC,						\
+	    typename B,							\
+	    typename BC>						\
+  auto operator OP(const Expr<A,AC>& a,					\
+		   const Expr<B,BC>& b)					\
+  {									\
+    return								\
+      BinaryExpr<OP_NAME,ExprRefOrVal<A>,ExprRefOrVal<B>>		\
+      (static_cast<const A&>(a),static_cast<const B&>(b));		\
+  }
+  
+  PROVIDE_BINARY_OPERATOR(+,SumOp);
+  
+  PROVIDE_BINARY_OPERATOR(-,SubtOp);
+  
+  PROVIDE_BINARY_OPERATOR(*,ProdOp);
+
+#undef PROVIDE_BINARY_OPERATOR
+  
+  /// Multiply a scalar by an expression
+  template <typename F,
+	    typename B,
+	    typename BC,
+	    ENABLE_THIS_TEMPLATE_IF(std::is_arithmetic_v<F>)>
+  auto operator*(const F& f,
+		 const Expr<B,BC>& b)
+  {
+    /// Scalar converted to the fundamental type of the expression
+    using S=
+      ScalarExpr<typename B::Fund>;
+    
+    return
+      BinaryExpr<ProdOp,S,ExprRefOrVal<B>>(S(f),static_cast<const B&>(b));
+  }
+  
+  /// Multiply an expression by a scalar
+  template <typename A,
+	    typename AC,
+	    typename F,
+	    ENABLE_THIS_TEMPLATE_IF(std::is_arithmetic_v<F>)>
+  auto operator*(const Expr<A,AC>& a,
+		 const F& f)
+  {
+    /// Scalar converted to the fundamental type of the expression
+    using S=
+      ScalarExpr<typename A::Fund>;
+    
+    return
+      BinaryExpr<ProdOp,ExprRefOrVal<A>,S>(static_cast<const A&>(a),S(f));
+  }
+  
+  /// Change sign to an expression
+  template <typename A,
+	    typename AC>
+  auto operator-(const Expr<A,AC>& a)
+  {
+    return
+      -1*a;
+  }
+}
+
+#endif
@@ -5,6 +5,7 @@
 # include "config.hpp"
 #endif
 
+#include <array>
 #include <tuple>
 #include <type_traits>
 
@@ -13,9 +14,12 @@
 #include "metaProgramming/cudaMacros.hpp"
 #include "metaProgramming/nonConstMethod.hpp"
 #include "metaProgramming/tagDispatch.hpp"
+#include "resources/parallelCopy.hpp"
 #include "tensors/complex.hpp"
 #include "tensors/component.hpp"
 #include "tensors/componentsList.hpp"
+#include "tensors/tensorFeat.hpp"
+#include "threads/pool.hpp"
 #include "unroll/forEachInTuple.hpp"
 #include "unroll/inliner.hpp"
 #include "utilities/tuple.hpp"
@@ -48,6 +52,10 @@ namespace maze
 	    typename ExpTCs>
   struct Expr
   {
+    /// All expressions can access each other internals
+    template <typename,
+	      typename>
+    friend struct Expr;
     
   private:
     
@@ -71,31 +79,66 @@ namespace maze
       return deFeat().eval(orderedTc);
     }
     
+    /// Subscribe evaluating the expression, non-const case
+    ///
+    /// The data is detached in advance, as the element can be written
+    template <typename...TC>
+    INLINE_FUNCTION CUDA_HOST_DEVICE
+    decltype(auto)_subscribe(FULLY_EVALUATE,
+			     const TensorCompFeat<TC>&...unorderedTc)
+    {
+      /// Reordered components
+      auto orderedTc=
+	fillTuple<TensorComps<TC...>>(unorderedTc.deFeat()...);
+      
+      deFeat().detach();
+      
+      return deFeat().eval(orderedTc);
+    }
+    
     /// Subscribe partially evaluating
     ///
-    /// Call the partialEval method
+    /// Binding already precomputes all that can be evaluated of the
+    /// subscribed components, such as the offset of a tensor slice,
+    /// so we forward to it
     template <typename...TC>
     INLINE_FUNCTION CUDA_HOST_DEVICE
-    void _subscribe(PARTIALLY_EVALUATE,
-		   const TensorCompFeat<TC>&...tc)
+    decltype(auto) _subscribe(PARTIALLY_EVALUATE,
+			      const TensorCompFeat<TC>&...tc)
       const
     {
-      CRASHER<<"Not implemented yet"<<endl;
-      /// TBI
+      return _subscribe(DISPATCH(BIND),tc.deFeat()...);
+    }
+    
+    /// Subscribe partially evaluating, non-const case
+    template <typename...TC>
+    INLINE_FUNCTION CUDA_HOST_DEVICE
+    decltype(auto) _subscribe(PARTIALLY_EVALUATE,
+			      const TensorCompFeat<TC>&...tc)
+    {
+      return _subscribe(DISPATCH(BIND),tc.deFeat()...);
     }
     
     /// Subcribe binding the component
     ///
-    /// Returns a bound expression
+    /// Returns the bound expression provided by the bind method
     template <typename...TC>
     INLINE_FUNCTION CUDA_HOST_DEVICE
-    void _subscribe(BIND,
-		   const TensorCompFeat<TC>&...tc)
+    decltype(auto) _subscribe(BIND,
+			      const TensorCompFeat<TC>&...tc)
       const
     {
-      CRASHER<<"Not implemented yet"<<endl;
-      ///TBI
-      }
+      return deFeat().bind(TensorComps<TC...>(tc.deFeat()...));
+    }
+    
+    /// Subcribe binding the component, non-const case
+    template <typename...TC>
+    INLINE_FUNCTION CUDA_HOST_DEVICE
+    decltype(auto) _subscribe(BIND,
+			      const TensorCompFeat<TC>&...tc)
+    {
+      return deFeat().bind(TensorComps<TC...>(tc.deFeat()...));
+    }
     
     /// Number of components
     static constexpr int nComps=
@@ -103,67 +146,252 @@ namespace maze
     
   public:
     
-    /// Subscrbe a single component
-    template <typename TC>
-    INLINE_FUNCTION CUDA_HOST_DEVICE
-    decltype(auto) operator[](const TensorCompFeat<TC>& tc) const
+    /// Provides the subscribe operators with the given constness
+    ///
+    /// Cannot use PROVIDE_ALSO_NON_CONST_METHOD, since binding
+    /// returns by value an expression whose constness must follow
+    /// that of this one
+#define PROVIDE_SUBSCRIBE_OPERATORS(CONST_ATTR)				\
+    /*! Subscribe a single component, CONST_ATTR case */		\
+    template <typename TC>						\
+    INLINE_FUNCTION CUDA_HOST_DEVICE					\
+    decltype(auto) operator[](const TensorCompFeat<TC>& tc) CONST_ATTR	\
+    {									\
+      static_assert((TupleHasType<TC,ExpTCs>),"Type not present in the expression"); \
+									\
+      /*! Check whether the subscribing lead to a full evaluation */	\
+      static constexpr bool fullyEval=					\
+	(nComps==1);							\
+									\
+      using HowToEvaluate=						\
+	std::conditional_t<fullyEval,FULLY_EVALUATE,BIND>;		\
+									\
+      return _subscribe(DISPATCH(HowToEvaluate),			\
+			tc.deFeat());					\
+    }									\
+									\
+    /*! Subscribe many components, CONST_ATTR case */			\
+    template <typename...TC>						\
+    INLINE_FUNCTION CUDA_HOST_DEVICE					\
+    decltype(auto) operator()(const TensorCompFeat<TC>&...tc) CONST_ATTR \
+    {									\
+      static_assert((TupleHasType<TC,ExpTCs>&...),"Types not present in the expression"); \
+									\
+      /*! Number of subscribed components */				\
+      static constexpr int nSubComps=					\
+	sizeof...(tc);							\
+									\
+      /*! Check whether the subscribing lead to a full evaluation */	\
+      static constexpr bool fullyEval=					\
+	(nSubComps==nComps);						\
+									\
+      using HowToEvaluate=						\
+	std::conditional_t<fullyEval,FULLY_EVALUATE,PARTIALLY_EVALUATE>; \
+									\
+      return _subscribe(DISPATCH(HowToEvaluate),			\
+			tc.deFeat()...);				\
+    }									\
+									\
+    /*! Subscribe many components in a tuple format, CONST_ATTR case */	\
+    template <typename...TC>						\
+    INLINE_FUNCTION CUDA_HOST_DEVICE					\
+    decltype(auto) operator()(const TensorComps<TC...>& tc) CONST_ATTR	\
+    {									\
+      return (*this)(std::get<TC>(tc)...);				\
+    }
+    
+    PROVIDE_SUBSCRIBE_OPERATORS(const);
+    
+    PROVIDE_SUBSCRIBE_OPERATORS(/* non const */);
+    
+#undef PROVIDE_SUBSCRIBE_OPERATORS
+    
+    /////////////////////////////////////////////////////////////////
+    
+    /// Check assignability of rhs into lhs
+    static void assertExprCanBeAssigned()
     {
-      static_assert((TupleHasType<TC,ExpTCs>),"Type not present in the expression");
-      
-      /// Check whether the subscribing lead to a full evaluation
-      static constexpr bool fullyEval=
-	(nComps==1);
-      
-      using HowToEvaluate=
-	std::conditional_t<fullyEval,FULLY_EVALUATE,BIND>;
-      
-      static_assert(std::is_same_v<HowToEvaluate,FULLY_EVALUATE>,"Cannot bind yet");
-      
-      return _subscribe(DISPATCH(HowToEvaluate),
-			tc.deFeat());
     }
     
-    /// Subscribe many components
-    template <typename...TC>
-    INLINE_FUNCTION CUDA_HOST_DEVICE
-    decltype(auto) operator()(const TensorCompFeat<TC>&...tc) const
+    /// Total number of elements spanned by all the components
+    auto nElements()
+      const
     {
-      static_assert((TupleHasType<TC,ExpTCs>&...),"Types not present in the expression");
-      
-      /// Number of subscribed components
-      static constexpr int nSubComps=
-	sizeof...(tc);
-      
-      /// Check whether the subscribing lead to a full evaluation
-      static constexpr bool fullyEval=
-	(nSubComps==nComps);
+      /// Result
+      typename T::Index n=1;
       
-      using HowToEvaluate=
-	std::conditional_t<fullyEval,FULLY_EVALUATE,BIND>;
-      
-      static_assert(std::is_same_v<HowToEvaluate,FULLY_EVALUATE>,"Cannot bind yet");
+      forEachInTuple(ExpTCs{},[this,&n](const auto& c)
+			      {
+				n*=
+				  deFeat().template compSize<std::decay_t<decltype(c)>>();
+			      });
       
-      return _subscribe(DISPATCH(HowToEvaluate),
-			tc.deFeat()...);
+      return n;
     }
     
-    /// Subscribe many components in a tuple format
-    template <typename...TC>
+    /// Takes a private copy of the data, if shared with other copies
+    ///
+    /// Nothing to be done by default, expressions holding data override it
     INLINE_FUNCTION CUDA_HOST_DEVICE
-    decltype(auto) operator()(const TensorComps<TC>&...tc) const
+    void detach()
     {
-      return (*this)(std::get<TC>(tc)...);
     }
     
-    PROVIDE_ALSO_NON_CONST_METHOD_GPU(operator());
+    /// Determine whether the rhs R can be assigned to this after simdifying both
+    ///
+    /// The last component of this must be the one absorbed into simd
+    /// by all the operands of the rhs
+    template <typename R>
+    static constexpr bool canAssignSimdified=
+      T::canBeSimdified and
+      R::canBeSimdified and
+      std::is_same_v<typename T::Fund,typename R::Fund> and
+      (std::is_void_v<typename R::SimdComp> or
+       std::is_same_v<typename T::SimdComp,typename R::SimdComp>);
     
-    PROVIDE_ALSO_NON_CONST_METHOD_GPU(operator[]);
+    /// Determine whether the rhs R can be assigned to this along the data
+    ///
+    /// The rhs must provide at each position of the data of this the
+    /// corresponding element, so that the assignment can be done with
+    /// a single loop on the data
+    template <typename R>
+    static constexpr bool canAssignLinearly=
+      T::template isLaidOutAs<typename T::StorageComps> and
+      R::template isLaidOutAs<typename T::StorageComps>;
     
-    /////////////////////////////////////////////////////////////////
+    /// Determine whether the rhs R can be copied bytewise into this
+    ///
+    /// The rhs must be a tensor, laid out as this in whatever storage order
+    template <typename R>
+    static constexpr bool canAssignByMemcpy=
+      canAssignLinearly<R> and
+      std::is_base_of_v<TensorFeat<R>,R> and
+      std::is_same_v<typename T::Fund,typename R::Fund> and
+      std::is_trivially_copyable_v<typename T::Fund>;
     
-    /// Check assignability of rhs into lhs
-    static void assertExprCanBeAssigned()
+    /// Determine whether the rhs R, without components, can be set bytewise into this
+    ///
+    /// The rhs can be a scalar, or any expression of scalars
+    template <typename R>
+    static constexpr bool canAssignByMemset=
+      canAssignLinearly<R> and
+      std::tuple_size_v<typename R::Comps> ==0 and
+      std::is_same_v<typename T::Fund,typename R::Fund> and
+      std::is_trivially_copyable_v<typename T::Fund>;
+    
+    /// Determine whether the rhs R is a tensor which can be copied into this, stored in a different order
+    template <typename R>
+    static constexpr bool canAssignByPermutedCopy=
+      (not canAssignLinearly<R>) and
+      std::is_base_of_v<TensorFeat<T>,T> and
+      std::is_base_of_v<TensorFeat<R>,R> and
+      std::tuple_size_v<typename R::Comps> ==nComps and
+      std::is_same_v<typename T::Fund,typename R::Fund>;
+    
+    /// Number of elements assigned by each iteration of the parallel linear loop
+    static constexpr int64_t LINEAR_ASSIGN_BLOCK_SIZE=
+      1<<12;
+    
+    /// Copy or set the rhs bytewise into this, if possible
+    ///
+    /// Returns false if the value of a rhs without components is not
+    /// made of repeated bytes, so that memset cannot be used
+    template <typename R>
+    bool tryAssignBytewise(const R& rhs)
     {
+      /// Type of the data
+      using Fund=
+	typename T::Fund;
+      
+      /// Number of bytes
+      const int64_t size=
+	(int64_t)nElements()*sizeof(Fund);
+      
+      if constexpr(canAssignByMemcpy<R>)
+	parallelMemcpy(this->deFeat().getDataPtr(),rhs.getDataPtr(),size);
+      else
+	{
+	  /// Value of the rhs, which has no component, evaluated once
+	  const Fund val=
+	    rhs.trivialAccess(0);
+	  
+	  /// Bytes of the value
+	  char bytes[sizeof(Fund)];
+	  memcpy(bytes,&val,sizeof(Fund));
+	  
+	  for(size_t i=1;i<sizeof(Fund);i++)
+	    if(bytes[i]!=bytes[0])
+	      return false;
+	  
+	  parallelMemset(this->deFeat().getDataPtr(),bytes[0],size);
+	}
+      
+      return true;
+    }
+    
+    /// Assign the rhs with a single loop on the data of this
+    ///
+    /// The loop can be vectorized by the compiler, and is split among
+    /// the threads in blocks if large enough
+    template <typename R>
+    void assignLinearly(const R& rhs)
+    {
+      /// Number of elements
+      const int64_t n=
+	nElements();
+      
+      /// Pointer to the data, detached from the possible copies once for all
+      auto* lhs=
+	this->deFeat().getDataPtr();
+      
+      /// Assign the elements in the range [beg,end)
+      auto assignRange=
+	[lhs,&rhs](const int64_t& beg,
+		   const int64_t& end)
+	{
+	  for(int64_t i=beg;i<end;i++)
+	    lhs[i]=rhs.trivialAccess(i);
+	};
+      
+      if(n>=ThreadPool::parallelAssignThreshold and
+	 not ThreadPool::isInsideParallelSection())
+	ThreadPool::loopSplit((int64_t)0,(n+LINEAR_ASSIGN_BLOCK_SIZE-1)/LINEAR_ASSIGN_BLOCK_SIZE,
+			      [n,&assignRange](const int64_t& iBlock)
+			      {
+				assignRange(iBlock*LINEAR_ASSIGN_BLOCK_SIZE,std::min(n,(iBlock+1)*LINEAR_ASSIGN_BLOCK_SIZE));
+			      });
+      else
+	assignRange(0,n);
+    }
+    
+    /// Copy the rhs tensor, stored in a different order, into this
+    ///
+    /// The copy is blocked in tiles and split among the threads by
+    /// parallelPermutedCopy
+    template <typename R>
+    void assignByPermutedCopy(const R& rhs)
+    {
+      /// Sizes of the components, in the storage order of this
+      std::array<int64_t,nComps> sizes;
+      
+      /// Strides of the components in this and in the rhs
+      std::array<int64_t,nComps> dstStrides,srcStrides;
+      
+      /// Position in the storage order
+      int p=0;
+      
+      forEachInTuple(typename T::StorageComps{},[this,&rhs,&sizes,&dstStrides,&srcStrides,&p](const auto& c)
+			      {
+				/// Component under analysis
+				using C=std::decay_t<decltype(c)>;
+				
+				sizes[p]=this->deFeat().template compSize<C>();
+				dstStrides[p]=this->deFeat().template stride<C>();
+				srcStrides[p]=rhs.template stride<C>();
+				p++;
+			      });
+      
+      parallelPermutedCopy(this->deFeat().getDataPtr(),rhs.getDataPtr(),sizes,dstStrides,srcStrides);
     }
     
     /// Assignment operator implementation
@@ -175,6 +403,8 @@ namespace maze
     {
       static_assert(T::canBeAssigned,"Trying to assign to a non-assignable expression");
       
+      static_assert(std::tuple_size_v<TupleFilterOut<ExpTCs,RCs>> ==0,"Rhs contains components not present in the lhs");
+      
       /// Dynamic components of THIS
       using DynTCs=
 	GetDynamicCompsOfTensorComps<ExpTCs>;
@@ -184,25 +414,72 @@ namespace maze
 				/// Component under analysis
 				using C=std::decay_t<decltype(t)>;
 				
-				const auto thisCompSize=
-				  rhs.deFeat().template compSize<C>();
-				
-				const auto rhsCompSize=
-				  this->deFeat().template compSize<C>();
-				
-				if(thisCompSize!=rhsCompSize)
-				  CRASHER<<"Dynamic component "<<nameOfType((C*)nullptr)<<" of lhs has size "<<thisCompSize<<" when rhs has size "<<rhsCompSize<<endl;
+				// The rhs is broadcast over the components it does not have
+				if constexpr(TupleHasType<C,RCs>)
+				  {
+				    const auto thisCompSize=
+				      this->deFeat().template compSize<C>();
+				    
+				    const auto rhsCompSize=
+				      rhs.deFeat().template compSize<C>();
+				    
+				    if(thisCompSize!=rhsCompSize)
+				      CRASHER<<"Dynamic component "<<nameOfType((C*)nullptr)<<" of lhs has size "<<thisCompSize<<" when rhs has size "<<rhsCompSize<<endl;
+				  }
 			      });
       
-      loopOnAllComponentsValues(this->deFeat(),
-				[this,&rhs](auto,const auto&...comps)
-				{
-				  /// Take components in a tule format
-				  const auto c=
-				    make_tuple(comps...);
-				  
-				  this->deFeat()(c)=rhs.deFeat()(c);
-				});
+      // Take a private copy of the data once for all, before any
+      // element is written, possibly by the threads
+      this->deFeat().detach();
+      
+      // Copy or set directly the memory if the rhs is laid out as this
+      if constexpr(canAssignByMemcpy<R> or canAssignByMemset<R>)
+	if(tryAssignBytewise(rhs.deFeat()))
+	  return this->deFeat();
+      
+      // Convert between storage orders with a blocked copy
+      if constexpr(canAssignByPermutedCopy<R>)
+	{
+	  assignByPermutedCopy(rhs.deFeat());
+	  
+	  return this->deFeat();
+	}
+      
+      // Evaluate in simd vectors if possible
+      if constexpr(canAssignSimdified<R>)
+	{
+	  this->deFeat().simdify()._assign(rhs.deFeat().simdify());
+	  
+	  return this->deFeat();
+	}
+      
+      // Run on the data if the rhs is laid out as this
+      if constexpr(canAssignLinearly<R>)
+	{
+	  assignLinearly(rhs.deFeat());
+	  
+	  return this->deFeat();
+	}
+      
+      /// Assign a single element
+      ///
+      /// The offset of the lhs is advanced by the loop, if possible
+      auto assignElement=
+	[this,&rhs](const auto& i,const auto& c)
+	{
+	  if constexpr(T::loopIndexIsDataOffset)
+	    this->deFeat().trivialAccess(i)=rhs.deFeat().eval(c);
+	  else
+	    this->deFeat().eval(c)=rhs.deFeat().eval(c);
+	};
+      
+      // Split the loop among threads only if large enough, and if
+      // not already inside a parallel section
+      if(nElements()>=ThreadPool::parallelAssignThreshold and
+	 not ThreadPool::isInsideParallelSection())
+	parallelLoopOnAllComponentsValues(this->deFeat(),assignElement);
+      else
+	loopOnAllComponentsValues(this->deFeat(),assignElement);
       
       return this->deFeat();
     }
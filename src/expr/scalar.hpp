@@ -0,0 +1,110 @@
+#ifndef _SCALAR_HPP
+#define _SCALAR_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file expr/scalar.hpp
+///
+/// \brief Wraps a scalar into an expression without components
+
+#include <expr/expr.hpp>
+#include <resources/simdTypes.hpp>
+
+namespace maze
+{
+  /// Scalar entering an expression
+  ///
+  /// Having no component, the scalar is broadcast over all the
+  /// components of the expression in which it enters
+  template <typename F>
+  struct ScalarExpr :
+    Expr<ScalarExpr<F>,TensorComps<>>
+  {
+    /// Scalar is copied when taken as argument in expression
+    static constexpr bool takeAsArgByRef=
+      false;
+    
+    /// Scalar cannot be assigned
+    static constexpr bool canBeAssigned=
+      false;
+    
+    /// A scalar has no data to loop on
+    static constexpr bool loopIndexIsDataOffset=
+      false;
+    
+    /// Fundamental type
+    using Fund=
+      F;
+    
+    /// Components
+    using Comps=
+      TensorComps<>;
+    
+    /// Type to be used for the index
+    using Index=
+      int;
+    
+    /// The scalar can be broadcast to a simd vector
+    static constexpr bool canBeSimdified=
+      simdOfTypeExists<F>;
+    
+    /// A scalar does not constrain the component absorbed into simd
+    using SimdComp=
+      void;
+    
+    /// The scalar provides the same value at any position
+    template <typename Cs>
+    static constexpr bool isLaidOutAs=
+      true;
+    
+    /// Stored value
+    const F val;
+    
+    /// Evaluate, ignoring all components
+    template <typename...C>
+    CUDA_HOST_DEVICE INLINE_FUNCTION
+    const F& eval(const TensorComps<C...>&)
+      const
+    {
+      return
+	val;
+    }
+    
+    /// Evaluate at the given position, ignoring it
+    template <typename I>
+    CUDA_HOST_DEVICE INLINE_FUNCTION
+    const F& trivialAccess(const I&)
+      const
+    {
+      return
+	val;
+    }
+    
+    /// Broadcast the scalar into all the lanes of a simd vector
+    template <typename _F=F,
+	      ENABLE_THIS_TEMPLATE_IF(simdOfTypeExists<_F>)>
+    auto simdify()
+      const
+    {
+      /// Broadcast value
+      Simd<F> res;
+      
+      for(int i=0;i<simdLength<F>;i++)
+	res[i]=val;
+      
+      return
+	ScalarExpr<Simd<F>>(res);
+    }
+    
+    /// Construct from the value
+    CUDA_HOST_DEVICE
+    ScalarExpr(const F& val) :
+      val(val)
+    {
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,230 @@
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file checkpoint.cpp
+
+#define EXTERN_CHECKPOINT
+# include "checkpoint.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <base/ranks.hpp>
+#include <debug/crasher.hpp>
+#include <threads/pool.hpp>
+#include <utilities/crc32c.hpp>
+
+namespace maze
+{
+  namespace resources
+  {
+    /// Layout of the region of a rank in a checkpoint file
+    struct CheckpointLayout
+    {
+      /// Header of the region
+      CheckpointRankHeader header;
+      
+      /// Headers of the entries
+      std::vector<CheckpointEntryHeader> entries;
+      
+      /// Position of the first checksum of each entry
+      std::vector<int64_t> firstChunk;
+      
+      /// Total number of chunks
+      int64_t nChunks;
+      
+      /// Size of header, entries and checksums
+      int64_t metadataSize() const
+      {
+	return sizeof(CheckpointRankHeader)+entries.size()*sizeof(CheckpointEntryHeader)+nChunks*sizeof(uint32_t);
+      }
+      
+      /// Number of chunks of the given size
+      static int64_t nChunksOfSize(const int64_t& size,
+				   const int64_t& chunkSize)
+      {
+	return (size+chunkSize-1)/chunkSize;
+      }
+      
+      /// Rounds up to the data alignment
+      static int64_t align(const int64_t& offset)
+      {
+	return (offset+FILE_DATA_ALIGNMENT-1)/FILE_DATA_ALIGNMENT*FILE_DATA_ALIGNMENT;
+      }
+      
+      /// Computes the layout of the entries, with the given chunk size
+      CheckpointLayout(const std::vector<Checkpoint::Entry>& in,
+		       const int64_t& chunkSize) :
+	header{},
+	entries(in.size()),
+	firstChunk(in.size()),
+	nChunks(0)
+      {
+	if(chunkSize<=0)
+	  CRASHER<<"Chunk size "<<chunkSize<<" must be positive"<<endl;
+	
+	for(size_t i=0;i<in.size();i++)
+	  {
+	    firstChunk[i]=nChunks;
+	    nChunks+=nChunksOfSize(in[i].size,chunkSize);
+	    
+	    entries[i]={};
+	    in[i].name.copy(entries[i].name,CheckpointEntryHeader::maxNameLength-1);
+	    entries[i].size=in[i].size;
+	  }
+	
+	/// Offset of the data of the next entry
+	int64_t offset=
+	  align(metadataSize());
+	
+	for(auto& e : entries)
+	  {
+	    e.dataOffset=offset;
+	    offset=align(offset+e.size);
+	  }
+	
+	memcpy(header.magic,CheckpointRankHeader::expectedMagic,sizeof(header.magic));
+	header.version=CheckpointRankHeader::expectedVersion;
+	header.rank=thisRank();
+	header.nRanks=nRranks();
+	header.regionSize=offset;
+	header.nEntries=entries.size();
+	header.chunkSize=chunkSize;
+      }
+    };
+    
+    /// Computes the checksum of each chunk of the data, in parallel
+    void checkpointChecksums(uint32_t* crcs,
+			     const void* data,
+			     const int64_t& size,
+			     const int64_t& chunkSize)
+    {
+      ThreadPool::loopSplit((int64_t)0,CheckpointLayout::nChunksOfSize(size,chunkSize),
+			    [crcs,data,size,chunkSize](const int64_t& iChunk)
+			    {
+			      /// Beginning of the chunk
+			      const int64_t beg=
+				iChunk*chunkSize;
+			      
+			      crcs[iChunk]=crc32c((const char*)data+beg,std::min(chunkSize,size-beg));
+			    });
+    }
+    
+    /// Crashes if the number of entries differs among ranks
+    void checkCheckpointNEntries(const int64_t& nEntries)
+    {
+      if(ranksAllReduceMax(nEntries)!=-ranksAllReduceMax(-nEntries))
+	CRASHER<<"Number of checkpoint entries "<<nEntries<<" differs among ranks"<<endl;
+    }
+  }
+  
+  void Checkpoint::addRaw(const std::string& name,
+			  void* ptr,
+			  const int64_t& size)
+  {
+    if((int)name.size()>=CheckpointEntryHeader::maxNameLength)
+      CRASHER<<"Checkpoint entry name "<<name<<" longer than "<<CheckpointEntryHeader::maxNameLength-1<<" characters"<<endl;
+    
+    for(const Entry& e : entries)
+      if(e.name==name)
+	CRASHER<<"Checkpoint entry "<<name<<" already registered"<<endl;
+    
+    entries.push_back({name,ptr,size});
+  }
+  
+  void Checkpoint::save(const std::string& path) const
+  {
+    resources::checkCheckpointNEntries(entries.size());
+    
+    /// Layout of the region of this rank
+    const resources::CheckpointLayout layout(entries,checkpointChunkSize);
+    
+    /// Offset of the region of this rank
+    const int64_t regionOffset=
+      ranksExclusiveScanSum(layout.header.regionSize);
+    
+    createFile(path,ranksAllReduceSum(layout.header.regionSize));
+    
+    /// Header, entries and checksums, written at the end
+    std::vector<char> metadata(layout.metadataSize());
+    
+    /// Checksums of all chunks
+    uint32_t* crcs=
+      (uint32_t*)(metadata.data()+sizeof(CheckpointRankHeader)+entries.size()*sizeof(CheckpointEntryHeader));
+    
+    for(size_t i=0;i<entries.size();i++)
+      {
+	const Entry& e=entries[i];
+	
+	resources::checkpointChecksums(crcs+layout.firstChunk[i],e.ptr,e.size,checkpointChunkSize);
+	
+	writeFileRegion(path,regionOffset+layout.entries[i].dataOffset,e.ptr,e.size);
+      }
+    
+    memcpy(metadata.data(),&layout.header,sizeof(CheckpointRankHeader));
+    memcpy(metadata.data()+sizeof(CheckpointRankHeader),layout.entries.data(),entries.size()*sizeof(CheckpointEntryHeader));
+    
+    writeFileRegion(path,regionOffset,metadata.data(),metadata.size());
+  }
+  
+  void Checkpoint::restore(const std::string& path) const
+  {
+    resources::checkCheckpointNEntries(entries.size());
+    
+    /// Header of the region of the first rank, providing the chunk size
+    CheckpointRankHeader firstHeader;
+    readFileRegion(path,0,&firstHeader,sizeof(CheckpointRankHeader));
+    
+    if(memcmp(firstHeader.magic,CheckpointRankHeader::expectedMagic,sizeof(firstHeader.magic)))
+      CRASHER<<"File "<<path<<" is not a checkpoint file"<<endl;
+    
+    if(firstHeader.version!=CheckpointRankHeader::expectedVersion)
+      CRASHER<<"File "<<path<<" has version "<<firstHeader.version<<", expected "<<CheckpointRankHeader::expectedVersion<<endl;
+    
+    if(firstHeader.nRanks!=nRranks())
+      CRASHER<<"File "<<path<<" was written by "<<firstHeader.nRanks<<" ranks, restoring with "<<nRranks()<<endl;
+    
+    /// Layout expected for the region of this rank
+    const resources::CheckpointLayout layout(entries,firstHeader.chunkSize);
+    
+    /// Offset of the region of this rank
+    const int64_t regionOffset=
+      ranksExclusiveScanSum(layout.header.regionSize);
+    
+    /// Header, entries and checksums read from the file
+    std::vector<char> metadata(layout.metadataSize());
+    readFileRegion(path,regionOffset,metadata.data(),metadata.size());
+    
+    if(memcmp(metadata.data(),&layout.header,sizeof(CheckpointRankHeader)))
+      CRASHER<<"Region of rank "<<thisRank()<<" of file "<<path<<" does not match the registered entries"<<endl;
+    
+    /// Entries read from the file
+    const CheckpointEntryHeader* fileEntries=
+      (const CheckpointEntryHeader*)(metadata.data()+sizeof(CheckpointRankHeader));
+    
+    for(size_t i=0;i<entries.size();i++)
+      if(memcmp(&fileEntries[i],&layout.entries[i],sizeof(CheckpointEntryHeader)))
+	CRASHER<<"Entry "<<i<<" of file "<<path<<" is "<<fileEntries[i].name<<" of "<<fileEntries[i].size<<" bytes, expected "<<entries[i].name<<" of "<<entries[i].size<<" bytes"<<endl;
+    
+    /// Checksums read from the file
+    const uint32_t* fileCrcs=
+      (const uint32_t*)(fileEntries+entries.size());
+    
+    /// Checksums of the restored data
+    std::vector<uint32_t> crcs(layout.nChunks);
+    
+    for(size_t i=0;i<entries.size();i++)
+      {
+	const Entry& e=entries[i];
+	
+	readFileRegion(path,regionOffset+layout.entries[i].dataOffset,e.ptr,e.size);
+	
+	resources::checkpointChecksums(crcs.data()+layout.firstChunk[i],e.ptr,e.size,layout.header.chunkSize);
+	
+	for(int64_t iChunk=layout.firstChunk[i];iChunk<layout.firstChunk[i]+resources::CheckpointLayout::nChunksOfSize(e.size,layout.header.chunkSize);iChunk++)
+	  if(crcs[iChunk]!=fileCrcs[iChunk])
+	    CRASHER<<"Checksum mismatch in chunk "<<iChunk-layout.firstChunk[i]<<" of entry "<<e.name<<" of file "<<path<<" on rank "<<thisRank()<<endl;
+      }
+  }
+}
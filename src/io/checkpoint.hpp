@@ -0,0 +1,151 @@
+#ifndef _CHECKPOINT_HPP
+#define _CHECKPOINT_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file checkpoint.hpp
+///
+/// \brief Checkpoint and restart of a set of registered tensors
+///
+/// Tensors are registered by name into a Checkpoint, which then
+/// saves their local data to a single file, or restores it. Each
+/// rank owns a contiguous region of the file, containing a header,
+/// the table of the registered entries, the checksums and the data of
+/// each entry, aligned to FILE_DATA_ALIGNMENT. The regions are laid
+/// out in order of rank.
+///
+/// The data of each entry is split into chunks of
+/// checkpointChunkSize bytes, whose CRC-32C is computed in parallel
+/// on the thread pool, and checked when restoring. Data is streamed
+/// directly between the tensors and the file, without copies.
+///
+/// All ranks must register the same entries in the same order, with
+/// possibly different sizes, and restore with the same ranks.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <io/file.hpp>
+#include <resources/storLoc.hpp>
+
+#ifndef EXTERN_CHECKPOINT
+# define EXTERN_CHECKPOINT extern
+#define INIT_CHECKPOINT_TO(...)
+#else
+# define INIT_CHECKPOINT_TO(...) (__VA_ARGS__)
+#endif
+
+namespace maze
+{
+  /// Size of the chunks whose checksum is computed independently
+  EXTERN_CHECKPOINT int64_t checkpointChunkSize INIT_CHECKPOINT_TO(1<<22);
+  
+  /// Header of the region of each rank in a checkpoint file
+  struct CheckpointRankHeader
+  {
+    /// Magic identifying the file
+    static constexpr char expectedMagic[8]=
+      {'M','A','Z','E','C','K','P','T'};
+    
+    /// Version of the format
+    static constexpr int64_t expectedVersion=
+      1;
+    
+    /// Magic read from the file
+    char magic[8];
+    
+    /// Version of the format
+    int64_t version;
+    
+    /// Rank owning the region
+    int64_t rank;
+    
+    /// Number of ranks which wrote the file
+    int64_t nRanks;
+    
+    /// Size of the region
+    int64_t regionSize;
+    
+    /// Number of entries
+    int64_t nEntries;
+    
+    /// Size of the chunks
+    int64_t chunkSize;
+  };
+  
+  /// Description of an entry of a checkpoint file
+  struct CheckpointEntryHeader
+  {
+    /// Maximal length of the name
+    static constexpr int maxNameLength=
+      64;
+    
+    /// Name of the entry, zero-padded
+    char name[maxNameLength];
+    
+    /// Number of bytes of the entry
+    int64_t size;
+    
+    /// Offset of the data from the beginning of the region
+    int64_t dataOffset;
+  };
+  
+  /// Set of tensors to be saved and restored together
+  struct Checkpoint
+  {
+    /// Memory registered under a name
+    struct Entry
+    {
+      /// Name of the entry
+      std::string name;
+      
+      /// Data to be saved or restored
+      void* ptr;
+      
+      /// Number of bytes
+      int64_t size;
+    };
+    
+    /// Registered entries
+    std::vector<Entry> entries;
+    
+    /// Registers size bytes at ptr under the given name
+    ///
+    /// The memory must stay valid and unmoved until the checkpoint is used
+    void addRaw(const std::string& name,
+		void* ptr,
+		const int64_t& size);
+    
+    /// Registers the local data of the tensor t under the given name
+    ///
+    /// The tensor must not be reallocated until the checkpoint is used
+    template <typename T>
+    void add(const std::string& name,
+	     T& t)
+    {
+#ifdef USE_CUDA
+      static_assert(T::storLoc==StorLoc::ON_CPU,"Only tensors on CPU can be checkpointed");
+#endif
+      
+      addRaw(name,t.getDataPtr(),t.data.getSize()*sizeof(typename T::Fund));
+    }
+    
+    /// Saves all the entries to the file
+    ///
+    /// Must be called by all ranks
+    void save(const std::string& path) const;
+    
+    /// Restores all the entries from the file, checking the checksums
+    ///
+    /// Must be called by all ranks
+    void restore(const std::string& path) const;
+  };
+}
+
+#undef EXTERN_CHECKPOINT
+#undef INIT_CHECKPOINT_TO
+
+#endif
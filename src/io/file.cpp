@@ -0,0 +1,253 @@
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file file.cpp
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <base/ranks.hpp>
+#include <debug/crasher.hpp>
+#include <io/file.hpp>
+
+namespace maze
+{
+  namespace resources
+  {
+    /// Largest number of bytes transferred in a single call
+    ///
+    /// MPI counts are int, and pread/pwrite might transfer less
+    constexpr int64_t FILE_CHUNK_SIZE=
+      1<<30;
+    
+#ifdef USE_MPI
+    
+    /// Open the file with MPI, crashing on failure
+    MPI_File mpiFileOpen(const std::string& path,
+			 const int& mode)
+    {
+      /// Handle to be returned
+      MPI_File fh;
+      
+      if(MPI_File_open(MPI_COMM_WORLD,path.c_str(),mode,MPI_INFO_NULL,&fh)!=MPI_SUCCESS)
+	CRASHER<<"Unable to open file "<<path<<endl;
+      
+      return fh;
+    }
+    
+    /// Access the file region with collective calls, one chunk at a time
+    ///
+    /// The number of calls is the same on all ranks, those with
+    /// fewer chunks passing empty ones. Crashes if a chunk is not
+    /// fully transferred, e.g. when reading past the end of the file
+    template <typename F>
+    void mpiFileAccessInChunks(const std::string& path,
+			       const int64_t& size,
+			       F&& f)
+    {
+      /// Number of chunks of this rank
+      const int64_t nChunks=
+	(size+FILE_CHUNK_SIZE-1)/FILE_CHUNK_SIZE;
+      
+      /// Number of chunks of all ranks
+      const int64_t nMaxChunks=
+	ranksAllReduceMax(nChunks);
+      
+      for(int64_t iChunk=0;iChunk<nMaxChunks;iChunk++)
+	{
+	  /// Beginning of the chunk
+	  const int64_t beg=
+	    std::min(size,iChunk*FILE_CHUNK_SIZE);
+	  
+	  /// Size of the chunk
+	  const int n=
+	    (int)(std::min(size,beg+FILE_CHUNK_SIZE)-beg);
+	  
+	  /// Status of the access
+	  MPI_Status status;
+	  
+	  if(f(beg,n,&status)!=MPI_SUCCESS)
+	    CRASHER<<"Failed to access file "<<path<<endl;
+	  
+	  /// Number of bytes actually transferred
+	  int nDone;
+	  MPI_Get_count(&status,MPI_BYTE,&nDone);
+	  
+	  if(nDone!=n)
+	    CRASHER<<"Accessed only "<<nDone<<" bytes of "<<n<<" at offset "<<beg<<" of the region of file "<<path<<", too short"<<endl;
+	}
+    }
+    
+#else
+    
+    /// Open the file, crashing on failure
+    int fileOpen(const std::string& path,
+		 const int& flags)
+    {
+      /// File descriptor to be returned
+      const int fd=
+	open(path.c_str(),flags,0644);
+      
+      if(fd<0)
+	CRASHER<<"Unable to open file "<<path<<": "<<strerror(errno)<<endl;
+      
+      return fd;
+    }
+    
+#endif
+  }
+  
+  void createFile(const std::string& path,
+		  const int64_t& size)
+  {
+#ifdef USE_MPI
+    /// Handle to the file
+    MPI_File fh=
+      resources::mpiFileOpen(path,MPI_MODE_CREATE|MPI_MODE_WRONLY);
+    
+    if(MPI_File_set_size(fh,size)!=MPI_SUCCESS)
+      CRASHER<<"Unable to resize file "<<path<<" to "<<size<<" bytes"<<endl;
+    
+    MPI_File_close(&fh);
+#else
+    /// Descriptor of the file
+    const int fd=
+      resources::fileOpen(path,O_CREAT|O_WRONLY);
+    
+    if(ftruncate(fd,size))
+      CRASHER<<"Unable to resize file "<<path<<" to "<<size<<" bytes: "<<strerror(errno)<<endl;
+    
+    close(fd);
+#endif
+  }
+  
+  void writeFileRegion(const std::string& path,
+		       const int64_t& offset,
+		       const void* data,
+		       const int64_t& size)
+  {
+#ifdef USE_MPI
+    /// Handle to the file
+    MPI_File fh=
+      resources::mpiFileOpen(path,MPI_MODE_WRONLY);
+    
+    resources::mpiFileAccessInChunks(path,size,
+				     [fh,offset,data](const int64_t& beg,
+						      const int& n,
+						      MPI_Status* status)
+				     {
+				       return MPI_File_write_at_all(fh,offset+beg,(const char*)data+beg,n,MPI_BYTE,status);
+				     });
+    
+    MPI_File_close(&fh);
+#else
+    /// Descriptor of the file
+    const int fd=
+      resources::fileOpen(path,O_WRONLY);
+    
+    for(int64_t done=0;done<size;)
+      {
+	/// Number of bytes written in this call
+	const ssize_t n=
+	  pwrite(fd,(const char*)data+done,std::min(size-done,resources::FILE_CHUNK_SIZE),offset+done);
+	
+	if(n<=0)
+	  CRASHER<<"Failed to write file "<<path<<": "<<strerror(errno)<<endl;
+	
+	done+=n;
+      }
+    
+    close(fd);
+#endif
+  }
+  
+  void readFileRegion(const std::string& path,
+		      const int64_t& offset,
+		      void* data,
+		      const int64_t& size)
+  {
+#ifdef USE_MPI
+    /// Handle to the file
+    MPI_File fh=
+      resources::mpiFileOpen(path,MPI_MODE_RDONLY);
+    
+    resources::mpiFileAccessInChunks(path,size,
+				     [fh,offset,data](const int64_t& beg,
+						      const int& n,
+						      MPI_Status* status)
+				     {
+				       return MPI_File_read_at_all(fh,offset+beg,(char*)data+beg,n,MPI_BYTE,status);
+				     });
+    
+    MPI_File_close(&fh);
+#else
+    /// Descriptor of the file
+    const int fd=
+      resources::fileOpen(path,O_RDONLY);
+    
+    for(int64_t done=0;done<size;)
+      {
+	/// Number of bytes read in this call
+	const ssize_t n=
+	  pread(fd,(char*)data+done,std::min(size-done,resources::FILE_CHUNK_SIZE),offset+done);
+	
+	if(n<=0)
+	  CRASHER<<"Failed to read file "<<path<<(n?": ":", too short")<<(n?strerror(errno):"")<<endl;
+	
+	done+=n;
+      }
+    
+    close(fd);
+#endif
+  }
+  
+  MappedFile::MappedFile(const std::string& path)
+  {
+    /// Descriptor of the file
+    const int fd=
+      open(path.c_str(),O_RDONLY);
+    
+    if(fd<0)
+      CRASHER<<"Unable to open file "<<path<<": "<<strerror(errno)<<endl;
+    
+    /// Properties of the file
+    struct stat st;
+    if(fstat(fd,&st))
+      CRASHER<<"Unable to get the size of file "<<path<<": "<<strerror(errno)<<endl;
+    
+    size=st.st_size;
+    
+    // An empty file cannot be mapped
+    if(size==0)
+      ptr=nullptr;
+    else
+      {
+	ptr=(char*)mmap(nullptr,size,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+	if(ptr==MAP_FAILED)
+	  CRASHER<<"Unable to map file "<<path<<": "<<strerror(errno)<<endl;
+      }
+    
+    // The mapping is kept after closing the descriptor
+    close(fd);
+  }
+  
+  MappedFile::~MappedFile()
+  {
+    if(ptr)
+      munmap(ptr,size);
+  }
+  
+  MappedFile::MappedFile(MappedFile&& oth) :
+    ptr(oth.ptr),
+    size(oth.size)
+  {
+    oth.ptr=nullptr;
+    oth.size=0;
+  }
+}
@@ -0,0 +1,76 @@
+#ifndef _FILE_HPP
+#define _FILE_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file file.hpp
+///
+/// \brief Raw access to files shared among ranks
+///
+/// Each rank writes or reads its own region of a single file, at an
+/// offset given by the caller. With MPI the access goes through
+/// MPI-IO collective calls, so all ranks must take part, possibly
+/// with an empty region. Without MPI, positioned read and write are
+/// used.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace maze
+{
+  /// Alignment of the data in files, allowing to map it in memory
+  constexpr int64_t FILE_DATA_ALIGNMENT=
+    4096;
+  
+  /// Creates the file, or resizes it if already existing, to size bytes
+  ///
+  /// Must be called by all ranks
+  void createFile(const std::string& path,
+		  const int64_t& size);
+  
+  /// Writes size bytes of data at offset of the file, which must exist
+  ///
+  /// Must be called by all ranks
+  void writeFileRegion(const std::string& path,
+		       const int64_t& offset,
+		       const void* data,
+		       const int64_t& size);
+  
+  /// Reads size bytes of data at offset of the file
+  ///
+  /// Must be called by all ranks
+  void readFileRegion(const std::string& path,
+		      const int64_t& offset,
+		      void* data,
+		      const int64_t& size);
+  
+  /// Map a file in memory, privately and read-write
+  ///
+  /// Modifications of the memory are not carried to the file. An
+  /// empty file is not mapped, and ptr is null
+  struct MappedFile
+  {
+    /// Beginning of the mapped memory
+    char* ptr;
+    
+    /// Size of the mapped memory
+    int64_t size;
+    
+    /// Map the file
+    MappedFile(const std::string& path);
+    
+    /// Unmap the file
+    ~MappedFile();
+    
+    /// Move constructor
+    MappedFile(MappedFile&& oth);
+    
+    /// Forbids copy, the mapping is owned
+    MappedFile(const MappedFile&)=delete;
+  };
+}
+
+#endif
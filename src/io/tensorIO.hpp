@@ -0,0 +1,345 @@
+#ifndef _TENSOR_IO_HPP
+#define _TENSOR_IO_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file tensorIO.hpp
+///
+/// \brief Binary input/output of tensors
+///
+/// A tensor file starts with a TensorFileHeader, followed by the
+/// description of the components and fundamental type of the
+/// tensor. The data starts at an offset aligned to
+/// FILE_DATA_ALIGNMENT, and is made of one block per rank, in order
+/// of rank, each containing the local data of the tensor in native
+/// byte order. Tensors not distributed among ranks are stored as a
+/// single block.
+///
+/// Since the blocks are laid out as the ranks grid, a distributed
+/// file can only be read back with the same ranks grid.
+
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <base/ranks.hpp>
+#include <debug/crasher.hpp>
+#include <debug/typeNamer.hpp>
+#include <io/file.hpp>
+
+namespace maze
+{
+  /// Header of a tensor file
+  struct TensorFileHeader
+  {
+    /// Maximal number of dynamic components, and of dimensions of the ranks grid
+    static constexpr int maxNSizes=
+      8;
+    
+    /// Magic identifying the file
+    static constexpr char expectedMagic[8]=
+      {'M','A','Z','E','T','E','N','S'};
+    
+    /// Version of the format
+    static constexpr int64_t expectedVersion=
+      1;
+    
+    /// Magic read from the file
+    char magic[8];
+    
+    /// Version of the format
+    int64_t version;
+    
+    /// Offset of the data from the beginning of the file
+    int64_t dataOffset;
+    
+    /// Length of the description following the header
+    int64_t descriptionLength;
+    
+    /// Size of the fundamental type
+    int64_t fundSize;
+    
+    /// Number of dynamic components
+    int64_t nDynSizes;
+    
+    /// Sizes of the dynamic components, in each block
+    int64_t dynSizes[maxNSizes];
+    
+    /// Number of dimensions of the ranks grid, zero if not distributed
+    int64_t nRanksDims;
+    
+    /// Number of ranks in each direction
+    int64_t nRanksPerDim[maxNSizes];
+    
+    /// Number of bytes of the block of each rank
+    int64_t bytesPerRank;
+    
+    /// Number of blocks
+    int64_t nBlocks() const
+    {
+      /// Result
+      int64_t res=1;
+      
+      for(int64_t mu=0;mu<nRanksDims;mu++)
+	res*=nRanksPerDim[mu];
+      
+      return res;
+    }
+    
+    /// Total size of the file
+    int64_t fileSize() const
+    {
+      return dataOffset+nBlocks()*bytesPerRank;
+    }
+  };
+  
+  namespace resources
+  {
+    /// Description of the type of the tensor T, stored in the file
+    template <typename T>
+    std::string tensorDescription()
+    {
+      return NAME_OF_TYPE(typename T::Comps)+" of "+NAME_OF_TYPE(typename T::Fund);
+    }
+    
+    /// Fills the header of the file where to store t
+    template <typename T>
+    TensorFileHeader tensorFileHeader(const T& t,
+				      const std::vector<int64_t>& nRanksPerDim)
+    {
+      /// Result
+      TensorFileHeader res{};
+      
+      /// Dynamic components
+      using DynamicComps=
+	typename T::DynamicComps;
+      
+      static_assert(std::tuple_size_v<DynamicComps> <=TensorFileHeader::maxNSizes,"Too many dynamic components to be stored");
+      
+      if((int)nRanksPerDim.size()>TensorFileHeader::maxNSizes)
+	CRASHER<<"Too many dimensions of the ranks grid to be stored: "<<nRanksPerDim.size()<<endl;
+      
+      memcpy(res.magic,TensorFileHeader::expectedMagic,sizeof(res.magic));
+      res.version=TensorFileHeader::expectedVersion;
+      res.descriptionLength=tensorDescription<T>().size();
+      res.dataOffset=
+	(sizeof(TensorFileHeader)+res.descriptionLength+FILE_DATA_ALIGNMENT-1)/FILE_DATA_ALIGNMENT*FILE_DATA_ALIGNMENT;
+      res.fundSize=sizeof(typename T::Fund);
+      
+      res.nDynSizes=std::tuple_size_v<DynamicComps>;
+      std::apply([&res](const auto&...s)
+		 {
+		   int i=0;
+		   ((res.dynSizes[i++]=s),...);
+		 },t.dynamicSizes);
+      
+      res.nRanksDims=nRanksPerDim.size();
+      for(int mu=0;mu<(int)nRanksPerDim.size();mu++)
+	res.nRanksPerDim[mu]=nRanksPerDim[mu];
+      
+      res.bytesPerRank=t.data.getSize()*sizeof(typename T::Fund);
+      
+      return res;
+    }
+    
+    /// Reads the header of the file, checking it against the type T and the ranks grid
+    template <typename T>
+    TensorFileHeader readTensorFileHeader(const std::string& path,
+					  const std::vector<int64_t>& nRanksPerDim)
+    {
+      /// Result
+      TensorFileHeader res;
+      
+      readFileRegion(path,0,&res,sizeof(TensorFileHeader));
+      
+      if(memcmp(res.magic,TensorFileHeader::expectedMagic,sizeof(res.magic)))
+	CRASHER<<"File "<<path<<" is not a tensor file"<<endl;
+      
+      if(res.version!=TensorFileHeader::expectedVersion)
+	CRASHER<<"File "<<path<<" has version "<<res.version<<", expected "<<TensorFileHeader::expectedVersion<<endl;
+      
+      /// Expected description
+      const std::string expectedDescription=
+	tensorDescription<T>();
+      
+      /// Description read from the file
+      std::string description(res.descriptionLength,' ');
+      readFileRegion(path,sizeof(TensorFileHeader),description.data(),res.descriptionLength);
+      
+      if(description!=expectedDescription or res.fundSize!=sizeof(typename T::Fund))
+	CRASHER<<"File "<<path<<" contains "<<description<<", expected "<<expectedDescription<<endl;
+      
+      if(res.nRanksDims!=(int64_t)nRanksPerDim.size() or
+	 not std::equal(nRanksPerDim.begin(),nRanksPerDim.end(),res.nRanksPerDim))
+	CRASHER<<"File "<<path<<" was written with a different ranks grid"<<endl;
+      
+      return res;
+    }
+    
+    /// Number of ranks per direction of the geometry, as a vector
+    template <typename G>
+    std::vector<int64_t> nRanksPerDimOfGeometry(const G& geo)
+    {
+      if(geo.ranksGrid.vol!=nRranks())
+	CRASHER<<"Ranks grid "<<geo.nRanksPerDim<<" does not match the number of ranks "<<nRranks()<<endl;
+      
+      return std::vector<int64_t>(geo.nRanksPerDim.data.begin(),geo.nRanksPerDim.data.end());
+    }
+    
+    /// Writes the data of t as block iBlock of the file, if doWrite is true
+    template <typename T>
+    void writeTensorBlock(const std::string& path,
+			  const T& t,
+			  const std::vector<int64_t>& nRanksPerDim,
+			  const int64_t& iBlock,
+			  const bool& doWrite)
+    {
+      /// Header of the file
+      const TensorFileHeader header=
+	tensorFileHeader(t,nRanksPerDim);
+      
+      createFile(path,header.fileSize());
+      
+      /// Header and description, written by the master rank only
+      std::vector<char> headerBuf(header.dataOffset,0);
+      memcpy(headerBuf.data(),&header,sizeof(TensorFileHeader));
+      memcpy(headerBuf.data()+sizeof(TensorFileHeader),tensorDescription<T>().data(),header.descriptionLength);
+      
+      writeFileRegion(path,0,headerBuf.data(),isMasterRank()?header.dataOffset:0);
+      
+      writeFileRegion(path,header.dataOffset+iBlock*header.bytesPerRank,t.getDataPtr(),doWrite?header.bytesPerRank:0);
+    }
+    
+    /// Reads block iBlock of the file into t
+    template <typename T>
+    void readTensorBlock(T& t,
+			 const std::string& path,
+			 const std::vector<int64_t>& nRanksPerDim,
+			 const int64_t& iBlock)
+    {
+      /// Header of the file
+      const TensorFileHeader header=
+	readTensorFileHeader<T>(path,nRanksPerDim);
+      
+      /// Header expected for t
+      const TensorFileHeader expected=
+	tensorFileHeader(t,nRanksPerDim);
+      
+      if(header.bytesPerRank!=expected.bytesPerRank or
+	 not std::equal(header.dynSizes,header.dynSizes+header.nDynSizes,expected.dynSizes))
+	CRASHER<<"File "<<path<<" contains blocks of "<<header.bytesPerRank<<" bytes, expected "<<expected.bytesPerRank<<endl;
+      
+      readFileRegion(path,header.dataOffset+iBlock*header.bytesPerRank,t.getDataPtr(),header.bytesPerRank);
+    }
+  }
+  
+  /// Writes the tensor t, not distributed among ranks
+  ///
+  /// Must be called by all ranks, only the master one writes the data
+  template <typename T>
+  void writeTensor(const std::string& path,
+		   const T& t)
+  {
+    resources::writeTensorBlock(path,t,{},0,isMasterRank());
+  }
+  
+  /// Writes the tensor t, each rank writing its local data in its block
+  template <typename T,
+	    typename G>
+  void writeTensor(const std::string& path,
+		   const T& t,
+		   const G& geo)
+  {
+    resources::writeTensorBlock(path,t,resources::nRanksPerDimOfGeometry(geo),thisRank(),true);
+  }
+  
+  /// Reads the tensor t, not distributed among ranks, which must have already the right sizes
+  template <typename T>
+  void readTensor(T& t,
+		  const std::string& path)
+  {
+    resources::readTensorBlock(t,path,{},0);
+  }
+  
+  /// Reads the local data of tensor t, which must have already the right sizes
+  template <typename T,
+	    typename G>
+  void readTensor(T& t,
+		  const std::string& path,
+		  const G& geo)
+  {
+    resources::readTensorBlock(t,path,resources::nRanksPerDimOfGeometry(geo),thisRank());
+  }
+  
+  /// Tensor whose data is mapped from a file
+  ///
+  /// The tensor refers to the mapped memory, which is private: it
+  /// can be modified without affecting the file
+  template <typename T>
+  struct MappedTensor
+  {
+    /// Mapped file
+    MappedFile file;
+    
+    /// Tensor referring to the mapped data
+    T tensor;
+    
+    /// Map the block iBlock of the file
+    MappedTensor(const std::string& path,
+		 const std::vector<int64_t>& nRanksPerDim,
+		 const int64_t& iBlock) :
+      MappedTensor(path,resources::readTensorFileHeader<T>(path,nRanksPerDim),iBlock)
+    {
+    }
+  
+  private:
+    
+    /// Map the block iBlock of the file, whose header has been read
+    MappedTensor(const std::string& path,
+		 const TensorFileHeader& header,
+		 const int64_t& iBlock) :
+      file(path),
+      tensor(mappedTensor(header,iBlock,std::make_index_sequence<std::tuple_size_v<typename T::DynamicComps>>()))
+    {
+      if(file.size<header.fileSize())
+	CRASHER<<"File "<<path<<" is "<<file.size<<" bytes long, expected "<<header.fileSize()<<endl;
+    }
+    
+    /// Creates the tensor referring to the block iBlock of the mapped file
+    template <size_t...I>
+    T mappedTensor(const TensorFileHeader& header,
+		   const int64_t& iBlock,
+		   std::index_sequence<I...>)
+    {
+      /// Dynamic components
+      using DynamicComps=
+	typename T::DynamicComps;
+      
+      return T((typename T::Fund*)(file.ptr+header.dataOffset+iBlock*header.bytesPerRank),
+	       header.bytesPerRank/sizeof(typename T::Fund),
+	       std::tuple_element_t<I,DynamicComps>(header.dynSizes[I])...);
+    }
+  };
+  
+  /// Maps the tensor from a file, not distributed among ranks
+  template <typename T>
+  MappedTensor<T> mapTensor(const std::string& path)
+  {
+    return MappedTensor<T>(path,{},0);
+  }
+  
+  /// Maps the local data of a tensor from a file
+  template <typename T,
+	    typename G>
+  MappedTensor<T> mapTensor(const std::string& path,
+			    const G& geo)
+  {
+    return MappedTensor<T>(path,resources::nRanksPerDimOfGeometry(geo),thisRank());
+  }
+}
+
+#endif
@@ -0,0 +1,162 @@
+#ifndef _HILBERT_HPP
+#define _HILBERT_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file Hilbert.hpp
+///
+/// \brief Hilbert-curve ordering of the sites of an hypercube
+///
+/// The hypercube is embedded into the smallest cube of side 2^nBits
+/// containing it, and each site is assigned the index along the
+/// Hilbert curve of the padded cube, computed with Skilling's
+/// algorithm. Sites are then ordered by increasing index, skipping
+/// the padding, so that sizes need not be powers of 2. Consecutive
+/// sites are always neighbors when the sizes are all equal to 2^nBits,
+/// and mostly so otherwise.
+
+#include <algorithm>
+
+#include <debug/crasher.hpp>
+#include <lattice/hCubeIndexer.hpp>
+#include <resources/vector.hpp>
+#include <threads/pool.hpp>
+
+namespace maze
+{
+  /// Structure to compute the Hilbert index
+  template <typename HC,
+	    typename HilbertIndex>
+  struct LxOfHilbertCalculator :
+    public LxIndexDeducer<LxOfHilbertCalculator<HC,HilbertIndex>>
+  {
+    /// Reference hCube
+    const HC& hCube;
+    
+    /// Number of dimensions
+    static constexpr int nDims=
+      HC::nDims;
+    
+    /// Index type
+    using LxIndex=
+      typename HC::Index;
+    
+    /// Number of bits per direction of the padded cube
+    int nBits;
+    
+    /// Lexicographic site of each Hilbert index
+    Vector<LxIndex> lxOfHilbert;
+    
+    /// Compute the Lx of a given Hilbert index
+    LxIndex operator()(const TensorComps<HilbertIndex>& hilbert) const
+    {
+      return lxOfHilbert[std::get<HilbertIndex>(hilbert)];
+    }
+    
+    /// Computes the position along the Hilbert curve of the padded cube
+    uint64_t keyOfCoords(Coords<nDims> x) const
+    {
+      /// Most significant bit
+      const int m=
+	1<<(nBits-1);
+      
+      // Undo the excess work
+      for(int q=m;q>1;q>>=1)
+	{
+	  /// Lower bits
+	  const int p=
+	    q-1;
+	  
+	  for(int i=0;i<nDims;i++)
+	    if(x[i]&q)
+	      x[0]^=p;
+	    else
+	      {
+		/// Bits to be exchanged
+		const int t=
+		  (x[0]^x[i])&p;
+		
+		x[0]^=t;
+		x[i]^=t;
+	      }
+	}
+      
+      // Gray encode
+      for(int i=1;i<nDims;i++)
+	x[i]^=x[i-1];
+      
+      /// Correction to be applied to all coordinates
+      int t=0;
+      for(int q=m;q>1;q>>=1)
+	if(x[nDims-1]&q)
+	  t^=q-1;
+      
+      for(int i=0;i<nDims;i++)
+	x[i]^=t;
+      
+      // Interleave the bits, from the most significant
+      
+      /// Result
+      uint64_t key=0;
+      
+      for(int b=nBits-1;b>=0;b--)
+	for(int i=0;i<nDims;i++)
+	  key=(key<<1)|((x[i]>>b)&1);
+      
+      return key;
+    }
+    
+    /// Constructor
+    LxOfHilbertCalculator(const HC& hCube) :
+      hCube(hCube),
+      nBits(1),
+      lxOfHilbert(hCube.vol)
+    {
+      while((1<<nBits)<hCube.sizes.maxAll())
+	nBits++;
+      
+      if(nBits*nDims>64)
+	CRASHER<<"Hilbert index of sizes "<<hCube.sizes<<" needs "<<nBits*nDims<<" bits, more than 64"<<endl;
+      
+      /// Position of each site along the curve of the padded cube
+      Vector<uint64_t> keys(hCube.vol);
+      
+      ThreadPool::loopSplit((int64_t)0,(int64_t)hCube.vol,
+			    [this,&keys](const int64_t& lx)
+			    {
+			      keys[lx]=keyOfCoords(this->hCube.computeCoordsOfLx(lx));
+			      lxOfHilbert[lx]=lx;
+			    });
+      
+      std::sort(lxOfHilbert.data,lxOfHilbert.data+hCube.vol,
+		[&keys](const LxIndex& a,const LxIndex& b)
+		{
+		  return keys[a]<keys[b];
+		});
+    }
+  };
+  
+  /// Returns a Hilbert index calculator
+  template <typename HilbertIndex,
+	    typename HC>
+  auto getLxOfHilbertCalculator(const HC& hCube)
+  {
+    return LxOfHilbertCalculator<HC,HilbertIndex>(hCube);
+  }
+  
+  /// Returns an index over an hypercube, following the Hilbert curve
+  template <typename HilbertSite,
+	    typename HC>
+  auto getHilbertIndexer(const HC& hCube)
+  {
+    /// Components to be used for the index
+    using HilbertSiteComps=
+      TensorComps<HilbertSite>;
+    
+    return getHCubeIndexer<HilbertSiteComps>(hCube,getLxOfHilbertCalculator<HilbertSite>(hCube),HilbertSiteComps{static_cast<HilbertSite>(hCube.vol)});
+  }
+}
+
+#endif
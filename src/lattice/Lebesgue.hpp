@@ -6,9 +6,21 @@
 #endif
 
 /// \file Lebesgue.hpp
+///
+/// \brief Space-filling ordering of the sites of an hypercube
+///
+/// The size of each direction is factorized, and the coordinates
+/// are written in the mixed base of the factors. The Lebesgue index
+/// interleaves the digits of all directions, so that sites close in
+/// the index are close in all directions. When all sizes are powers
+/// of 2 the digits are bits, and the index is the Morton one.
+
+#include <array>
+#include <vector>
 
 #include <lattice/hCubeIndexer.hpp>
 #include <utilities/factorize.hpp>
+#include <utilities/math.hpp>
 
 namespace maze
 {
@@ -32,46 +44,48 @@ namespace maze
     /// Factors needed to compute Leb index
     std::vector<std::vector<int>> factors;
     
+    /// Digit of the mixed-radix representation of the Lebesgue index
+    struct Digit
+    {
+      /// Radix
+      int64_t radix;
+      
+      /// Weight in the lexicographic index
+      int64_t lxWeight;
+    };
+    
+    /// Digits of the Lebesgue index, from the least significant, skipping those of radix 1
+    std::vector<Digit> digits;
+    
+    /// Whether all sizes are powers of 2, so that digits are bits
+    bool isMorton;
+    
+    /// Bits of the Lebesgue index forming the coordinate in each direction, when isMorton
+    std::array<uint64_t,nDims> bitsOfDir;
+    
+    /// Stride of each direction in the lexicographic index
+    std::array<int64_t,nDims> lxStrides;
+    
     /// Compute the Lx of a given Lebesgue
     LxIndex operator()(const TensorComps<LebIndex>& _Leb) const
     {
-      LebIndex Leb=std::get<LebIndex>(_Leb);
-      
-      /// Number of factors
-      const size_t& nFactors=factors.size();
-      Coords<nDims> c,t1,t2,t3;
+      /// Index to be converted
+      int64_t Leb=std::get<LebIndex>(_Leb);
       
-      for(int i=0;i<nDims;i++)
-	{
-	  t1[i]=t2[i]=c[i]=0;
-	  t3[i]=(nDims*nFactors-1)%nFactors;
-	}
-      
-      /// Convert to mixed base
-      int xMixedBase[nDims][nDims*nFactors];
-      memset(xMixedBase,0,sizeof(xMixedBase));
-      
-      for(int i=0;i<(int)(nDims*nFactors);i++)
-	{
-	  int mu=nDims-1-(i%nDims);
-	  int f=factors[t1[mu]][mu];
-	  
-	  xMixedBase[mu][t2[mu]]=Leb%f;
-	  Leb/=f;
-	  
-	  t1[mu]=(t1[mu]+1)%nFactors;
-	  t2[mu]++;
-	}
+      /// Result
+      int64_t lx=0;
       
-      //build coordinate in lx format
-      for(int mu=0;mu<nDims;mu++)
-	for(int j=nDims*nFactors-1;j>=0;j--)
+      if(isMorton)
+	for(int mu=0;mu<nDims;mu++)
+	  lx+=(int64_t)extractBits(Leb,bitsOfDir[mu])*lxStrides[mu];
+      else
+	for(const Digit& d : digits)
 	  {
-	    c[mu]=xMixedBase[mu][j]+factors[t3[mu]][mu]*c[mu];
-	    t3[mu]=(t3[mu]+nFactors-1)%nFactors;
+	    lx+=(Leb%d.radix)*d.lxWeight;
+	    Leb/=d.radix;
 	  }
       
-      return hCube.computeLxOfCoords(c);
+      return lx;
     }
     
     /// Constructor
@@ -97,6 +111,41 @@ namespace maze
 	  for(int ifact=0;ifact<nFacts;ifact++)
 	    factors[nFacts1+ifact][mu]=listFactMu[ifact];
 	}
+      
+      for(int64_t mu=nDims-1,stride=1;mu>=0;stride*=hCube.sizes[mu--])
+	lxStrides[mu]=stride;
+      
+      // The i-th factor of each direction is a digit of the Lebesgue
+      // index, the last direction being the fastest, weighting in the
+      // coordinate as the product of the previous factors
+      
+      /// Weight of the next digit in the coordinate of each direction
+      Coords<nDims> coordWeight=
+	Coords<nDims>::getAll(1);
+      
+      isMorton=true;
+      for(int mu=0;mu<nDims;mu++)
+	isMorton&=isPowerOf2(hCube.sizes[mu]);
+      
+      bitsOfDir.fill(0);
+      
+      for(int i=0;i<nMaxFacts;i++)
+	for(int mu=nDims-1;mu>=0;mu--)
+	  {
+	    /// Radix of the digit
+	    const int f=
+	      factors[i][mu];
+	    
+	    if(f!=1)
+	      {
+		bitsOfDir[mu]|=(uint64_t)1<<digits.size();
+		
+		digits.push_back({f,coordWeight[mu]*lxStrides[mu]});
+		coordWeight[mu]*=f;
+	      }
+	  }
+      
+      isMorton&=(digits.size()<64);
     }
   };
   
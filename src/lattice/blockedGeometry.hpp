@@ -0,0 +1,253 @@
+#ifndef _BLOCKED_GEOMETRY_HPP
+#define _BLOCKED_GEOMETRY_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file blockedGeometry.hpp
+///
+/// \brief Ordering of the local sites by parity, block and site inside the block
+///
+/// The local lattice is tiled into blocks of equal sizes. Inside
+/// each block, sites are paired along a direction of even block size
+/// as in the even/odd layout, so that a site is identified by the
+/// components Parity, BlockId and BlockedEosSite. Tensors stored in
+/// this order keep the sites of a block and parity contiguous. The
+/// rank is the slowest index of the global ordering, each rank
+/// storing its own local sites.
+
+#include <vector>
+
+#include <debug/crasher.hpp>
+#include <lattice/geometry.hpp>
+#include <lattice/hCubeIndexer.hpp>
+#include <resources/cacheSizes.hpp>
+#include <threads/pool.hpp>
+
+namespace maze
+{
+  /// Blocked ordering of the local sites of a geometry
+  template <typename G>
+  struct BlockedGeometry
+  {
+    /// Number of dimensions
+    static constexpr int nDims=
+      G::nDims;
+    
+    /// Direction index
+    using Direction=
+      typename G::Direction;
+    
+    /// Local site
+    using LocSite=
+      typename G::LocSite;
+    
+    /// Parity
+    using Parity=
+      typename G::Parity;
+    
+    DECLARE_COMPONENT(BlockId,int64_t,DYNAMIC,blockId);
+    DECLARE_COMPONENT(BlockedEosSite,int64_t,DYNAMIC,blockedEosSite);
+    
+    /// Components identifying a site in the blocked ordering
+    using BlockedComps=
+      TensorComps<Parity,BlockId,BlockedEosSite>;
+    
+    /// Reference geometry
+    const G& geo;
+    
+    /// Sizes of each block
+    const Coords<nDims> blockSizes;
+    
+    /// Direction along which the sites of a block are paired
+    const Direction splitDir;
+    
+    /// Sizes of the pair of sites of opposite parity
+    const Coords<nDims> paritySizes;
+    
+    /// Grid of the blocks
+    const HCube<nDims,BlockId,HASHED> blocksGrid;
+    
+    /// Grid of the pairs of sites inside each block
+    const HCube<nDims,BlockedEosSite,HASHED> blockedEosGrid;
+    
+    /// Computes the components of a local site
+    struct BlockedOfLxDeducer :
+      IndexDeducerFromLx<BlockedOfLxDeducer>
+    {
+      /// Reference blocked geometry
+      const BlockedGeometry& bg;
+      
+      /// Compute the components
+      BlockedComps operator()(const TensorComps<LocSite>& lx) const
+      {
+	/// Local coordinates
+	const Coords<nDims> c=
+	  bg.geo.locCoordsOfLocLx(std::get<LocSite>(lx));
+	
+	return
+	  {bg.geo.parityOfLocLx(std::get<LocSite>(lx)),
+	   bg.blocksGrid.computeLxOfCoords(c/bg.blockSizes),
+	   bg.blockedEosGrid.computeLxOfCoords(c%bg.blockSizes/bg.paritySizes)};
+      }
+      
+      /// Construct taking the blocked geometry
+      BlockedOfLxDeducer(const BlockedGeometry& bg) :
+	bg(bg)
+      {
+      }
+    };
+    
+    /// Mapping between the local sites and the blocked ones
+    const HCubeIndexer<BlockedComps,typename G::LocGrid> indexer;
+    
+    /// Components of a local site
+    const BlockedComps& blockedOfLx(const LocSite& lx) const
+    {
+      return indexer.idOfLx(TensorComps<LocSite>{lx});
+    }
+    
+    /// Local site of the passed components
+    const LocSite& lxOfBlocked(const Parity& par,
+			       const BlockId& blockId,
+			       const BlockedEosSite& blockedEosSite) const
+    {
+      return std::get<LocSite>(indexer.lxOfId(BlockedComps{par,blockId,blockedEosSite}));
+    }
+    
+    /// Copy a field from the lexicographic layout to the blocked one
+    template <typename TOut,
+	      typename TIn>
+    void lxToBlocked(TOut&& out,
+		     const TIn& in) const
+    {
+      ThreadPool::loopSplit((int64_t)0,(int64_t)geo.locVol,
+			    [this,&out,&in](const int64_t& lx)
+			    {
+			      const auto& [par,blockId,blockedEosSite]=
+				blockedOfLx(lx);
+			      
+			      out(par,blockId,blockedEosSite)=in(LocSite(lx));
+			    });
+    }
+    
+    /// Copy a field from the blocked layout to the lexicographic one
+    template <typename TOut,
+	      typename TIn>
+    void blockedToLx(TOut&& out,
+		     const TIn& in) const
+    {
+      ThreadPool::loopSplit((int64_t)0,(int64_t)geo.locVol,
+			    [this,&out,&in](const int64_t& lx)
+			    {
+			      const auto& [par,blockId,blockedEosSite]=
+				blockedOfLx(lx);
+			      
+			      out(LocSite(lx))=in(par,blockId,blockedEosSite);
+			    });
+    }
+    
+    /// Choose the largest block fitting in the passed cache size
+    ///
+    /// The block sizes divide the local ones, at least one of them is
+    /// even, and the block volume times bytesPerSite does not exceed
+    /// cacheSize. Among blocks of equal volume, that with the smallest
+    /// surface is chosen.
+    static Coords<nDims> computeBlockSizes(const Coords<nDims>& locSizes,
+					   const int64_t& bytesPerSite,
+					   const int64_t& cacheSize=l2CacheSize()/2)
+    {
+      /// Divisors of the local size in each direction
+      std::vector<int> divisors[nDims];
+      
+      for(int mu=0;mu<nDims;mu++)
+	for(int d=1;d<=locSizes[mu];d++)
+	  if(locSizes[mu]%d==0)
+	    divisors[mu].push_back(d);
+      
+      /// Best block sizes found
+      Coords<nDims> best{};
+      
+      /// Volume and surface of the best block
+      int64_t bestVol=0,bestSurf=0;
+      
+      /// Position in the list of divisors of each direction
+      Coords<nDims> iDiv{};
+      
+      /// Try all combinations of divisors, as an odometer
+      for(bool done=false;not done;)
+	{
+	  /// Candidate sizes
+	  Coords<nDims> sizes;
+	  for(int mu=0;mu<nDims;mu++)
+	    sizes[mu]=divisors[mu][iDiv[mu]];
+	  
+	  /// Volume of the candidate
+	  const int64_t vol=
+	    sizes.prodAll();
+	  
+	  /// Surface of the candidate
+	  int64_t surf=0;
+	  for(int mu=0;mu<nDims;mu++)
+	    surf+=vol/sizes[mu];
+	  
+	  if(sizes.fastestLocalEvenDimension()!=nDims and
+	     vol*bytesPerSite<=cacheSize and
+	     (vol>bestVol or (vol==bestVol and surf<bestSurf)))
+	    {
+	      best=sizes;
+	      bestVol=vol;
+	      bestSurf=surf;
+	    }
+	  
+	  /// Direction to be advanced
+	  int mu=nDims-1;
+	  while(mu>=0 and ++iDiv[mu]==(int)divisors[mu].size())
+	    iDiv[mu--]=0;
+	  
+	  done=(mu<0);
+	}
+      
+      if(bestVol==0)
+	CRASHER<<"No block of local sizes "<<locSizes<<" with an even size fits "<<cacheSize<<" bytes with "<<bytesPerSite<<" bytes per site"<<endl;
+      
+      return best;
+    }
+    
+    /// Returns the block sizes, after checking that they can tile the local lattice
+    static const Coords<nDims>& checkBlockSizes(const Coords<nDims>& locSizes,
+						const Coords<nDims>& blockSizes)
+    {
+      if((locSizes%blockSizes).sumAll())
+	CRASHER<<"Local sizes "<<locSizes<<" incompatible with block sizes "<<blockSizes<<endl;
+      
+      if(blockSizes.fastestLocalEvenDimension()==nDims)
+	CRASHER<<"Block sizes "<<blockSizes<<" must be even in at least one direction"<<endl;
+      
+      return blockSizes;
+    }
+    
+    /// Construct from the geometry, choosing the blocks to fit half the L2 cache
+    BlockedGeometry(const G& geo,
+		    const int64_t& bytesPerSite) :
+      BlockedGeometry(geo,computeBlockSizes(geo.locSizes,bytesPerSite))
+    {
+    }
+    
+    /// Construct from the geometry and the sizes of the blocks
+    BlockedGeometry(const G& geo,
+		    const Coords<nDims>& blockSizes) :
+      geo(geo),
+      blockSizes(checkBlockSizes(geo.locSizes,blockSizes)),
+      splitDir(blockSizes.fastestLocalEvenDimension()),
+      paritySizes(Coords<nDims>::versor(splitDir)+1),
+      blocksGrid(geo.locSizes/blockSizes,allDimensions<nDims>),
+      blockedEosGrid(blockSizes/paritySizes,allDimensions<nDims>),
+      indexer(geo.locGrid,BlockedOfLxDeducer(*this),TensorComps<BlockId,BlockedEosSite>{blocksGrid.vol,blockedEosGrid.vol})
+    {
+    }
+  };
+}
+
+#endif
@@ -7,6 +7,7 @@
 
 /// \file coords.hpp
 
+#include <algorithm>
 #include <array>
 #include <ostream>
 
@@ -130,6 +131,17 @@ namespace maze
       return coordsProd;
     }
     
+    /// Largest of all the coordinates
+    int maxAll() const
+    {
+      int coordsMax=(*this)[0];
+      
+      for(Direction mu=1;mu<nDims;mu++)
+	coordsMax=std::max(coordsMax,(*this)[mu]);
+      
+      return coordsMax;
+    }
+    
     /// Returns a versor
     static Coords<nDims> versor(Direction mu)
     {
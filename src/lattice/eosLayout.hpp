@@ -0,0 +1,264 @@
+#ifndef _EOS_LAYOUT_HPP
+#define _EOS_LAYOUT_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file eosLayout.hpp
+///
+/// \brief Even/odd split of the local sites
+///
+/// The local sites are grouped in pairs along a direction of even
+/// local size, each pair containing one even and one odd site. The
+/// pairs are indexed by EosSite, so that a site is identified by the
+/// components Parity and EosSite, and tensors can be stored with all
+/// sites of a given parity contiguous.
+
+#include <array>
+
+#include <debug/crasher.hpp>
+#include <lattice/geometry.hpp>
+#include <lattice/hCubeIndexer.hpp>
+#include <resources/vector.hpp>
+#include <threads/pool.hpp>
+
+namespace maze
+{
+  /// Even/odd layout of the local sites of a geometry
+  template <typename G>
+  struct EosLayout
+  {
+    /// Number of dimensions
+    static constexpr int nDims=
+      G::nDims;
+    
+    /// Number of oriented directions
+    static constexpr int nOrientedDirs=
+      G::nOrientedDirs;
+    
+    /// Direction index
+    using Direction=
+      typename G::Direction;
+    
+    /// Local site
+    using LocSite=
+      typename G::LocSite;
+    
+    /// Parity
+    using Parity=
+      typename G::Parity;
+    
+    /// Site inside a parity
+    using EosSite=
+      typename G::EosSite;
+    
+    /// Components identifying a site in the even/odd layout
+    using EosComps=
+      TensorComps<Parity,EosSite>;
+    
+    /// Hypercube of the pairs of sites
+    using EosGrid=
+      HCube<nDims,EosSite,NOT_HASHED>;
+    
+    /// Reference geometry
+    const G& geo;
+    
+    /// Direction along which sites are paired
+    const Direction splitDir;
+    
+    /// Hypercube of the pairs, halved along splitDir with respect to the local one
+    const EosGrid eosGrid;
+    
+    /// Computes the local site of the passed parity and pair
+    struct LxOfEosDeducer :
+      LxIndexDeducer<LxOfEosDeducer>
+    {
+      /// Reference layout
+      const EosLayout& layout;
+      
+      /// Compute the local site
+      LocSite operator()(const EosComps& eosComps) const
+      {
+	/// Coordinates of the pair
+	Coords<nDims> c=
+	  layout.eosGrid.computeCoordsOfLx(std::get<EosSite>(eosComps));
+	
+	c[layout.splitDir]*=2;
+	
+	/// Parity of the first site of the pair
+	const Parity firstPar=
+	  layout.geo.parityOfLocLx(layout.geo.computeLxOfLocCoords(c));
+	
+	c[layout.splitDir]+=(std::get<Parity>(eosComps)!=firstPar);
+	
+	return
+	  layout.geo.computeLxOfLocCoords(c);
+      }
+      
+      /// Construct taking the layout
+      LxOfEosDeducer(const EosLayout& layout) :
+	layout(layout)
+      {
+      }
+    };
+    
+    /// Mapping between the local sites and the even/odd ones
+    const HCubeIndexer<EosComps,typename G::LocGrid> indexer;
+    
+    /// Number of halo sites of each parity
+    std::array<EosSite,2> haloVolOfParity;
+    
+    /// Index of each halo site inside its parity, starting from locVolH
+    Vector<EosSite> eosOfHaloSite;
+    
+    /// Neighbors of each even/odd site, which have opposite parity
+    ///
+    /// Neighbors in the halo are indexed starting from locVolH
+    Vector<EosSite> neighsTable;
+    
+    /// Number of sites of each parity needed to store a field with halo
+    EosSite volHWithHalo() const
+    {
+      return geo.locVolH+std::max(haloVolOfParity[0],haloVolOfParity[1]);
+    }
+    
+    /// Parity and even/odd index of a local site
+    const EosComps& eosOfLx(const LocSite& lx) const
+    {
+      return indexer.idOfLx(TensorComps<LocSite>{lx});
+    }
+    
+    /// Local site of the passed parity and even/odd index
+    const LocSite& lxOfEos(const Parity& par,
+			   const EosSite& eos) const
+    {
+      return std::get<LocSite>(indexer.lxOfId(EosComps{par,eos}));
+    }
+    
+    /// Neighbor of the site of passed parity and index, in the oriented direction dir
+    const EosSite& neighOfEos(const Parity& par,
+			      const EosSite& eos,
+			      const int& dir) const
+    {
+      return neighsTable[(par*geo.locVolH+eos)*nOrientedDirs+dir];
+    }
+    
+    /// Copy a field from the lexicographic layout to the even/odd one
+    ///
+    /// The input must have the LocSite component, the output the
+    /// Parity and EosSite ones
+    template <typename TOut,
+	      typename TIn>
+    void lxToEos(TOut&& out,
+		 const TIn& in) const
+    {
+      ThreadPool::loopSplit((int64_t)0,(int64_t)geo.locVol,
+			    [this,&out,&in](const int64_t& lx)
+			    {
+			      const auto& [par,eos]=
+				eosOfLx(lx);
+			      
+			      out(par,eos)=in(LocSite(lx));
+			    });
+    }
+    
+    /// Copy a field from the even/odd layout to the lexicographic one
+    template <typename TOut,
+	      typename TIn>
+    void eosToLx(TOut&& out,
+		 const TIn& in) const
+    {
+      ThreadPool::loopSplit((int64_t)0,(int64_t)geo.locVol,
+			    [this,&out,&in](const int64_t& lx)
+			    {
+			      const auto& [par,eos]=
+				eosOfLx(lx);
+			      
+			      out(LocSite(lx))=in(par,eos);
+			    });
+    }
+    
+    /// Choose the direction along which to pair the sites
+    Direction computeSplitDir() const
+    {
+      /// Result
+      const Direction res=
+	geo.locSizes.fastestLocalEvenDimension();
+      
+      if(res==nDims)
+	CRASHER<<"No local direction of even size in "<<geo.locSizes<<", cannot split even and odd sites"<<endl;
+      
+      return res;
+    }
+    
+    /// Compute the parity of the halo sites, and their index inside the parity
+    void initHalo()
+    {
+      /// Parity of each halo site
+      Vector<Parity> haloParity(geo.locGrid.haloVol);
+      
+      for(LocSite lx=0;lx<geo.locVol;lx++)
+	for(int dir=0;dir<nOrientedDirs;dir++)
+	  {
+	    /// Neighbor of the site
+	    const LocSite neigh=
+	      geo.locGrid.neighOfLx(lx,dir);
+	    
+	    if(neigh>=geo.locVol)
+	      haloParity[neigh-geo.locVol]=1-geo.parityOfLocLx(lx);
+	  }
+      
+      eosOfHaloSite=
+	Vector<EosSite>(geo.locGrid.haloVol);
+      
+      haloVolOfParity={0,0};
+      for(LocSite h=0;h<geo.locGrid.haloVol;h++)
+	eosOfHaloSite[h]=geo.locVolH+haloVolOfParity[haloParity[h]]++;
+    }
+    
+    /// Compute the table of the neighbors
+    void initNeighsTable()
+    {
+      neighsTable=
+	Vector<EosSite>(geo.locVol*nOrientedDirs);
+      
+      ThreadPool::loopSplit((int64_t)0,(int64_t)geo.locVol,
+			    [this](const int64_t& lx)
+			    {
+			      const auto& [par,eos]=
+				eosOfLx(lx);
+			      
+			      for(int dir=0;dir<nOrientedDirs;dir++)
+				{
+				  /// Neighbor in lexicographic layout
+				  const LocSite neigh=
+				    geo.locGrid.neighOfLx(lx,dir);
+				  
+				  neighsTable[(par*geo.locVolH+eos)*nOrientedDirs+dir]=
+				    (neigh<geo.locVol)?
+				    std::get<EosSite>(eosOfLx(neigh)):
+				    eosOfHaloSite[neigh-geo.locVol];
+				}
+			    });
+    }
+    
+    /// Construct from the geometry
+    EosLayout(const G& geo) :
+      geo(geo),
+      splitDir(computeSplitDir()),
+      eosGrid(geo.locSizes/(Coords<nDims>::versor(splitDir)+1),geo.isDirectionFullyLocal),
+      indexer(geo.locGrid,LxOfEosDeducer(*this),TensorComps<EosSite>{geo.locVolH})
+    {
+      for(Direction mu=0;mu<nDims;mu++)
+	if(geo.glbSizes[mu]%2)
+	  CRASHER<<"Global size "<<geo.glbSizes<<" must be even in all directions, for neighbors to have opposite parity"<<endl;
+      
+      initHalo();
+      
+      initNeighsTable();
+    }
+  };
+}
+
+#endif
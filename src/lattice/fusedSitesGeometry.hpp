@@ -0,0 +1,295 @@
+#ifndef _FUSED_SITES_GEOMETRY_HPP
+#define _FUSED_SITES_GEOMETRY_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file fusedSitesGeometry.hpp
+///
+/// \brief Virtual-node layout, fusing sites into simd vectors
+///
+/// The local lattice is divided into nVNodes sub-lattices, the
+/// virtual nodes, arranged on the hypercube vNodesGrid. The sites of
+/// all virtual nodes having the same coordinates inside their
+/// sub-lattice form a fused site, whose sites are the lanes of a
+/// simd vector. Tensors with components (FusedSite,...,VNode) can
+/// therefore always be simdified, whatever the other components.
+///
+/// The neighbor of a fused site is a fused site, with the same
+/// lanes, except when moving across the border of the sub-lattice:
+/// then the lanes must be permuted, to take the data from the
+/// neighboring virtual node.
+///
+/// The local lattice is treated as periodic, so shifting is only
+/// possible in directions which are fully local: otherwise the lanes
+/// wrapping around the local lattice would have to be taken from the
+/// halo received from the neighboring rank, which is not supported.
+
+#include <array>
+
+#include <debug/crasher.hpp>
+#include <lattice/geometry.hpp>
+#include <resources/simdTypes.hpp>
+#include <resources/vector.hpp>
+#include <threads/pool.hpp>
+
+namespace maze
+{
+  /// Virtual-node layout of the local sites of a geometry, for the fundamental type F
+  template <typename G,
+	    typename F>
+  struct FusedSitesGeometry
+  {
+    /// Number of dimensions
+    static constexpr int nDims=
+      G::nDims;
+    
+    /// Number of oriented directions
+    static constexpr int nOrientedDirs=
+      G::nOrientedDirs;
+    
+    /// Number of virtual nodes
+    static constexpr int nVNodes=
+      simdLength<F>;
+    
+    /// Direction index
+    using Direction=
+      typename G::Direction;
+    
+    /// Local site
+    using LocSite=
+      typename G::LocSite;
+    
+    DECLARE_COMPONENT(VNode,int,nVNodes,vNode);
+    DECLARE_COMPONENT(FusedSite,int64_t,DYNAMIC,fusedSite);
+    
+    /// Hypercube of the virtual nodes
+    using VNodesGrid=
+      HCube<nDims,VNode,HASHED>;
+    
+    /// Hypercube of the fused sites
+    using FusedSitesGrid=
+      HCube<nDims,FusedSite,HASHED>;
+    
+    /// Reference geometry
+    const G& geo;
+    
+    /// Virtual nodes grid
+    const VNodesGrid vNodesGrid;
+    
+    /// Fused sites grid, periodic as the lanes are permuted when wrapping
+    const FusedSitesGrid fusedSitesGrid;
+    
+    /// Number of fused sites
+    const FusedSite& fusedVol=
+      fusedSitesGrid.vol;
+    
+    /// Lane from which each lane takes its neighbor, when crossing the border of the virtual node
+    std::array<std::array<VNode,nVNodes>,nOrientedDirs> lanesPerm;
+    
+    /// For each fused site, bit dir is set if the lanes must be permuted to reach the neighbor in dir
+    Vector<uint32_t> permuteMask;
+    
+    /// Local site of each fused site and virtual node
+    Vector<LocSite> lxOfFusedSiteTable;
+    
+    /// Distribute the virtual nodes among the dimensions of the local lattice
+    ///
+    /// Each factor 2 goes to the direction with largest fused size divisible by 2
+    static Coords<nDims> computeVNodesSizes(const Coords<nDims>& locSizes)
+    {
+      /// Result
+      Coords<nDims> res=
+	Coords<nDims>::getAll(1);
+      
+      for(int n=nVNodes;n>1;n/=2)
+	{
+	  /// Direction with the largest fused size
+	  int bestMu=nDims;
+	  
+	  for(int mu=0;mu<nDims;mu++)
+	    {
+	      /// Size of the fused sites along mu
+	      const int fusedSize=
+		locSizes[mu]/res[mu];
+	      
+	      if(fusedSize%2==0 and (bestMu==nDims or fusedSize>locSizes[bestMu]/res[bestMu]))
+		bestMu=mu;
+	    }
+	  
+	  if(bestMu==nDims)
+	    CRASHER<<"Cannot split local sizes "<<locSizes<<" into "<<nVNodes<<" virtual nodes"<<endl;
+	  
+	  res[bestMu]*=2;
+	}
+      
+      return res;
+    }
+    
+    /// Local site of a fused site and virtual node
+    const LocSite& lxOfFusedSite(const FusedSite& fusedSite,
+				 const VNode& vNode) const
+    {
+      return lxOfFusedSiteTable[fusedSite*nVNodes+vNode];
+    }
+    
+    /// Computes the local site of a fused site and virtual node
+    LocSite computeLxOfFusedSite(const FusedSite& fusedSite,
+				 const VNode& vNode) const
+    {
+      return geo.computeLxOfLocCoords(vNodesGrid.coordsOfLx(vNode)*fusedSitesGrid.sizes+
+				      fusedSitesGrid.coordsOfLx(fusedSite));
+    }
+    
+    /// Neighbor of a fused site in the oriented direction dir
+    FusedSite neighOfFusedSite(const FusedSite& fusedSite,
+			       const int& dir) const
+    {
+      return fusedSitesGrid.neighOfLx(fusedSite,dir);
+    }
+    
+    /// Returns whether the lanes must be permuted to reach the neighbor in dir
+    bool needsPermute(const FusedSite& fusedSite,
+		      const int& dir) const
+    {
+      return (permuteMask[fusedSite]>>dir)&1;
+    }
+    
+    /// Permute the lanes of x to get the neighbor across the border of the virtual node in dir
+    Simd<F> permute(const Simd<F>& x,
+		    const int& dir) const
+    {
+      /// Result
+      Simd<F> res;
+      
+      for(int vNode=0;vNode<nVNodes;vNode++)
+	res[vNode]=x[lanesPerm[dir][vNode]()];
+      
+      return res;
+    }
+    
+    /// Copy a field from the lexicographic layout to the fused one
+    template <typename TOut,
+	      typename TIn>
+    void lxToFused(TOut&& out,
+		   const TIn& in) const
+    {
+      ThreadPool::loopSplit((int64_t)0,(int64_t)fusedVol,
+			    [this,&out,&in](const int64_t& fusedSite)
+			    {
+			      for(VNode vNode=0;vNode<nVNodes;vNode++)
+				out(FusedSite(fusedSite),vNode)=in(lxOfFusedSite(fusedSite,vNode));
+			    });
+    }
+    
+    /// Copy a field from the fused layout to the lexicographic one
+    template <typename TOut,
+	      typename TIn>
+    void fusedToLx(TOut&& out,
+		   const TIn& in) const
+    {
+      ThreadPool::loopSplit((int64_t)0,(int64_t)fusedVol,
+			    [this,&out,&in](const int64_t& fusedSite)
+			    {
+			      for(VNode vNode=0;vNode<nVNodes;vNode++)
+				out(lxOfFusedSite(fusedSite,vNode))=in(FusedSite(fusedSite),vNode);
+			    });
+    }
+    
+    /// Sets out on each fused site to in on its neighbor in dir
+    ///
+    /// Both tensors must have FusedSite as first component and VNode
+    /// as last, so that the data of each fused site is a contiguous
+    /// set of simd vectors.
+    ///
+    /// The direction must be fully local: the halo is not used, and
+    /// the lanes wrapping around the local lattice would otherwise
+    /// take the data of the wrong sites, so we crash
+    template <typename TOut,
+	      typename TIn>
+    void shift(TOut&& out,
+	       const TIn& in,
+	       const int& dir) const
+    {
+      if(not geo.isDirectionFullyLocal[dir%nDims])
+	CRASHER<<"Cannot shift fused sites in direction "<<dir<<", not fully local"<<endl;
+      
+      /// Components of the input
+      using InComps=
+	typename std::decay_t<TIn>::Comps;
+      
+      static_assert(std::is_same_v<std::tuple_element_t<0,InComps>,FusedSite> and
+		    std::is_same_v<std::tuple_element_t<std::tuple_size_v<InComps>-1,InComps>,VNode>,
+		    "Tensor must have FusedSite as first component and VNode as last");
+      
+      /// Number of simd vectors per fused site
+      const int64_t nSimdPerSite=
+	in.data.getSize()/nVNodes/fusedVol;
+      
+      ThreadPool::loopSplit((int64_t)0,(int64_t)fusedVol,
+			    [this,&out,&in,dir,nSimdPerSite](const int64_t& fusedSite)
+			    {
+			      /// Source
+			      const Simd<F>* s=
+				(const Simd<F>*)in.getDataPtr()+neighOfFusedSite(fusedSite,dir)*nSimdPerSite;
+			      
+			      /// Destination
+			      Simd<F>* d=
+				(Simd<F>*)out.getDataPtr()+fusedSite*nSimdPerSite;
+			      
+			      if(needsPermute(fusedSite,dir))
+				for(int64_t i=0;i<nSimdPerSite;i++)
+				  d[i]=permute(s[i],dir);
+			      else
+				for(int64_t i=0;i<nSimdPerSite;i++)
+				  d[i]=s[i];
+			    });
+    }
+    
+    /// Construct from the geometry, choosing the virtual nodes sizes
+    FusedSitesGeometry(const G& geo) :
+      FusedSitesGeometry(geo,computeVNodesSizes(geo.locSizes))
+    {
+    }
+    
+    /// Construct from the geometry and the virtual nodes sizes
+    FusedSitesGeometry(const G& geo,
+		       const Coords<nDims>& vNodesSizes) :
+      geo(geo),
+      vNodesGrid(vNodesSizes,allDimensions<nDims>),
+      fusedSitesGrid(geo.locSizes/vNodesSizes,allDimensions<nDims>),
+      permuteMask(fusedVol),
+      lxOfFusedSiteTable(geo.locVol)
+    {
+      if((geo.locSizes%vNodesSizes).sumAll() or vNodesGrid.vol!=nVNodes)
+	CRASHER<<"Local sizes "<<geo.locSizes<<" incompatible with virtual nodes sizes "<<vNodesSizes<<endl;
+      
+      for(int dir=0;dir<nOrientedDirs;dir++)
+	for(VNode vNode=0;vNode<nVNodes;vNode++)
+	  lanesPerm[dir][vNode]=vNodesGrid.neighOfLx(vNode,dir);
+      
+      fusedSitesGrid.initNeighsTable();
+      
+      ThreadPool::loopSplit((int64_t)0,(int64_t)fusedVol,
+			    [this](const int64_t& fusedSite)
+			    {
+			      /// Coordinates of the fused site
+			      const Coords<nDims> c=
+				fusedSitesGrid.computeCoordsOfLx(fusedSite);
+			      
+			      permuteMask[fusedSite]=0;
+			      for(int ori=0;ori<2;ori++)
+				for(Direction mu=0;mu<nDims;mu++)
+				  if(vNodesGrid.sizes[mu]>1 and c[mu]==(ori?fusedSitesGrid.sizes[mu]-1:0))
+				    permuteMask[fusedSite]|=1u<<World<nDims>::orientedDir(ori,mu);
+			      
+			      for(VNode vNode=0;vNode<nVNodes;vNode++)
+				lxOfFusedSiteTable[fusedSite*nVNodes+vNode]=
+				  computeLxOfFusedSite(fusedSite,vNode);
+			    });
+    }
+  };
+}
+
+#endif
@@ -7,6 +7,7 @@
 
 /// \file geometry.hpp
 
+#include <base/ranks.hpp>
 #include <lattice/hCube.hpp>
 #include <lattice/world.hpp>
 #include <tensors/component.hpp>
@@ -15,8 +16,11 @@ namespace maze
 {
   /// Structure to incapsulate the lexicographic grids needed to move across a lattice
   ///
-  /// In the naming scheme, Lx denotes a site
-  template <int _NDims=4>
+  /// In the naming scheme, Lx denotes a site. If StaticLocSizes are
+  /// passed, the local grid has sizes fixed at compile time, and the
+  /// geometry can only be constructed with matching local sizes
+  template <int _NDims=4,
+	    int...StaticLocSizes>
   struct Geometry
   {
     /// Number of dimensions
@@ -33,6 +37,7 @@ namespace maze
     
     DECLARE_COMPONENT(GlbSite,int64_t,DYNAMIC,glbSite);
     DECLARE_COMPONENT(LocSite,int64_t,DYNAMIC,locSite);
+    DECLARE_COMPONENT(EosSite,int64_t,DYNAMIC,eosSite);
     DECLARE_COMPONENT(Rank,int32_t,DYNAMIC,rank);
     DECLARE_COMPONENT(Parity,int8_t,2,parity);
     
@@ -57,9 +62,12 @@ namespace maze
     using RanksGrid=
       HCube<nDims,Rank,HASHED>;
     
-    /// Local lattice grid
+    /// Local lattice grid, computing the coordinates without table
+    ///
+    /// Static sizes fold the divisions at compile time, otherwise the
+    /// divisions are replaced by multiplications
     using LocGrid=
-      HCube<nDims,LocSite,HASHED>;
+      HCube<nDims,LocSite,(sizeof...(StaticLocSizes)?NOT_HASHED:FAST_DIVIDE),StaticLocSizes...>;
     
     /// Global site grid
     const GlbGrid glbGrid;
@@ -79,7 +87,7 @@ namespace maze
     const Coords<nDims>& nRanksPerDim=
 	    ranksGrid.sizes;
     
-    /// Neighoboring ranks
+    /// Neighoboring ranks, indexed by oriented direction
     const std::array<Rank,nOrientedDirs> rankNeighs;
     
     /// Store whether the directions are fully local
@@ -132,8 +140,8 @@ namespace maze
       return locGrid.computeLxOfCoords(coords);
     }
     
-    /// Returns local site coords
-    const Coords<nDims>& locCoordsOfLocLx(const LocSite& locLx) const
+    /// Returns local site coords, by reference if the grid holds a table
+    decltype(auto) locCoordsOfLocLx(const LocSite& locLx) const
     {
       return locGrid.coordsOfLx(locLx);
     }
@@ -157,6 +165,33 @@ namespace maze
       return glbCoords;
     }
     
+    /// Compute the ranks neighboring the current one in each oriented direction
+    std::array<Rank,nOrientedDirs> computeRankNeighs() const
+    {
+      /// Coordinates of the current rank
+      const Coords<nDims> rankCoords=
+	ranksGrid.computeCoordsOfLx(rank(thisRank()));
+      
+      /// Result
+      std::array<Rank,nOrientedDirs> res;
+      
+      for(int ori=0;ori<2;ori++)
+	for(Direction mu=0;mu<nDims;mu++)
+	  {
+	    /// Coordinates of the neighbor, wrapping around the ranks grid
+	    Coords<nDims> neighCoords=
+	      rankCoords;
+	    
+	    neighCoords[mu]=
+	      (neighCoords[mu]+nRanksPerDim[mu]+2*ori-1)%nRanksPerDim[mu];
+	    
+	    res[World<nDims>::orientedDir(ori,mu)]=
+	      ranksGrid.computeLxOfCoords(neighCoords);
+	  }
+      
+      return res;
+    }
+    
     /// Returns an hypercube of size 1x1x...x2(mu)x1...
     ParityHCube getParityGrid(const Direction& mu) const
     {
@@ -169,6 +204,7 @@ namespace maze
 	     const Coords<nDims>& ranksSizes) :
       glbGrid(glbSizes,allDimensions<nDims>),
       ranksGrid(ranksSizes,allDimensions<nDims>),
+      rankNeighs(computeRankNeighs()),
       isDirectionFullyLocal(ranksSizes==1 /* compare each direction to 1 */),
       locGrid(glbSizes/ranksSizes,isDirectionFullyLocal),
       _locLxParityTable(locVol,[this](const LocSite& lx)
@@ -7,15 +7,28 @@
 
 /// \file hCube.hpp
 
+#include <array>
+
+#include <cstdint>
+
+#include <debug/crasher.hpp>
 #include <lattice/lxCoordsProvider.hpp>
 #include <lattice/world.hpp>
+#include <resources/vector.hpp>
+#include <threads/pool.hpp>
+#include <unroll/unrolledFor.hpp>
 
 namespace maze
 {
   /// Hypercube
+  ///
+  /// If StaticSizes are passed, the sizes are known at compile time,
+  /// and the lexicographic index and the coordinates are computed
+  /// with constant multiplications and divisions
   template <int _NDims,
 	    typename _Index,
-	    UseHashedCoords UHC>
+	    UseHashedCoords UHC,
+	    int...StaticSizes>
   struct HCube
   {
     /// Number of dimensions
@@ -30,10 +43,24 @@ namespace maze
     using Direction=
       typename World<nDims>::Direction;
     
+    /// Number of oriented directions
+    static constexpr int nOrientedDirs=
+      World<nDims>::nOrientedDirs;
+    
     /// Keep trace if hashed or not
     static constexpr UseHashedCoords isHashed=
       UHC;
     
+    /// Keep trace whether the sizes are known at compile time
+    static constexpr bool hasStaticSizes=
+      sizeof...(StaticSizes)>0;
+    
+    static_assert(not hasStaticSizes or sizeof...(StaticSizes)==nDims,"Static sizes must be given for all dimensions");
+    
+    /// Sizes known at compile time, if any
+    static constexpr std::array<int,sizeof...(StaticSizes)> staticSizes=
+      {StaticSizes...};
+    
     /// Sizes of the hypercube
     const Coords<nDims> sizes;
     
@@ -52,9 +79,26 @@ namespace maze
     /// Compute the bulk volume
     const Index bulkVol;
     
+    /// Number of sites in the halo of each oriented direction
+    ///
+    /// The halo of a non-periodic direction contains the face of the
+    /// hypercube orthogonal to it, periodic directions have no halo
+    const std::array<Index,nOrientedDirs> haloSizes;
+    
+    /// Offset of the halo of each oriented direction, from the end of the volume
+    const std::array<Index,nOrientedDirs> haloOffsets;
+    
+    /// Total number of sites of the halo
+    const Index haloVol;
+    
     /// Holds the coordinates or compute them
     HashedOrNotLxCoords<nDims,Index,UHC> coordsProvider;
     
+    /// Table of the neighbors of all sites, empty unless initNeighsTable is called
+    ///
+    /// Mutable, as it only caches what computeNeighOfLx returns
+    mutable Vector<Index> neighsTable;
+    
     /// Construct from sizes
     HCube(const Coords<nDims>& sizes,
 	   const Coords<nDims>& periodic) :
@@ -64,14 +108,24 @@ namespace maze
       volH(vol/2),
       hasBulk(computeHasBulk()),
       bulkVol(computeBulkVol()),
+      haloSizes(computeHaloSizes()),
+      haloOffsets(computeHaloOffsets()),
+      haloVol(haloOffsets[nOrientedDirs-1]+haloSizes[nOrientedDirs-1]),
       coordsProvider(*this)
     {
+      if constexpr(hasStaticSizes)
+	for(Direction mu=0;mu<nDims;mu++)
+	  if(sizes[mu]!=staticSizes[mu])
+	    CRASHER<<"Sizes "<<sizes<<" do not match the static ones"<<endl;
     }
     
     /// Compute the volume
     Index computeVol() const
     {
-      return Index(sizes.prodAll());
+      if constexpr(hasStaticSizes)
+	return Index((StaticSizes*...));
+      else
+	return Index(sizes.prodAll());
     }
     
     /// Check if the hypercube has a bulk
@@ -109,13 +163,122 @@ namespace maze
       return computeVol()-computeBulkVol();
     }
     
+    /// Compute the number of sites in the halo of each oriented direction
+    std::array<Index,nOrientedDirs> computeHaloSizes() const
+    {
+      /// Result
+      std::array<Index,nOrientedDirs> res;
+      
+      for(int ori=0;ori<2;ori++)
+	for(Direction mu=0;mu<nDims;mu++)
+	  res[World<nDims>::orientedDir(ori,mu)]=
+	    periodic[mu]?
+	    0:
+	    computeVol()/sizes[mu];
+      
+      return res;
+    }
+    
+    /// Compute the offset of the halo of each oriented direction
+    std::array<Index,nOrientedDirs> computeHaloOffsets() const
+    {
+      /// Result
+      std::array<Index,nOrientedDirs> res;
+      
+      res[0]=0;
+      for(int dir=1;dir<nOrientedDirs;dir++)
+	res[dir]=res[dir-1]+haloSizes[dir-1];
+      
+      return res;
+    }
+    
+    /// Computes the lexicographic index of the coordinates in the face orthogonal to mu
+    ///
+    /// This is the position of the site in the halo of the
+    /// neighboring hypercube along mu
+    Index computeFaceLxOfCoords(const Coords<nDims>& coords,
+				const Direction& mu) const
+    {
+      Index out=0;
+      
+      for(Direction nu=0;nu<nDims;nu++)
+	if(nu!=mu)
+	  out=out*sizes[nu]+coords[nu];
+      
+      return out;
+    }
+    
+    /// Computes the neighbor of a site in the oriented direction dir
+    ///
+    /// Neighbors across the border of a non-periodic direction are
+    /// placed in the halo, after the volume
+    Index computeNeighOfLx(const Index& site,
+			   const int& dir) const
+    {
+      /// Direction of motion
+      const Direction mu=
+	dir%nDims;
+      
+      /// Orientation, 0 for backward, 1 for forward
+      const int ori=
+	dir/nDims;
+      
+      /// Coordinates of the neighbor
+      Coords<nDims> coords=
+	computeCoordsOfLx(site);
+      
+      coords[mu]+=2*ori-1;
+      
+      if(coords[mu]<0 or coords[mu]>=sizes[mu])
+	{
+	  if(periodic[mu])
+	    coords[mu]=(coords[mu]+sizes[mu])%sizes[mu];
+	  else
+	    return vol+haloOffsets[dir]+computeFaceLxOfCoords(coords,mu);
+	}
+      
+      return computeLxOfCoords(coords);
+    }
+    
+    /// Fills the table of the neighbors of all sites
+    void initNeighsTable() const
+    {
+      neighsTable=
+	Vector<Index>(vol*nOrientedDirs);
+      
+      ThreadPool::loopSplit((int64_t)0,(int64_t)vol,
+			    [this,neighs=neighsTable.data](const int64_t& site)
+			    {
+			      for(int dir=0;dir<nOrientedDirs;dir++)
+				neighs[site*nOrientedDirs+dir]=
+				  computeNeighOfLx(site,dir);
+			    });
+    }
+    
+    /// Returns the neighbor of a site in the oriented direction dir, using lookup table if available
+    Index neighOfLx(const Index& site,
+		    const int& dir) const
+    {
+      if(neighsTable.size())
+	return neighsTable[site*nOrientedDirs+dir];
+      else
+	return computeNeighOfLx(site,dir);
+    }
+    
     /// Computes the lexicographic index
     Index computeLxOfCoords(const Coords<nDims>& coords) const
     {
       Index out=0;
       
-      for(Direction mu=0;mu<nDims;mu++)
-	out=out*sizes[mu]+coords[mu];
+      if constexpr(hasStaticSizes)
+	{
+	  UNROLLED_FOR(mu,nDims)
+	    out=out*staticSizes[mu]+coords[mu];
+	  UNROLLED_FOR_END;
+	}
+      else
+	for(Direction mu=0;mu<nDims;mu++)
+	  out=out*sizes[mu]+coords[mu];
       
       return out;
     }
@@ -126,11 +289,28 @@ namespace maze
       /// Result coordinates
       Coords<nDims> coords;
       
-      for(Direction mu=nDims-1;mu>=0;mu--)
+      if constexpr(hasStaticSizes)
 	{
-	  coords[mu]=site%sizes[mu];
-	  site/=sizes[mu];
+	  /// Site as unsigned, so that divisions by constants fold to multiplications and shifts
+	  uint64_t uSite=site;
+	  
+	  UNROLLED_FOR(i,nDims)
+	    {
+	      /// Direction, from the fastest
+	      const int mu=
+		nDims-1-i;
+	      
+	      coords[mu]=uSite%staticSizes[mu];
+	      uSite/=staticSizes[mu];
+	    }
+	  UNROLLED_FOR_END;
 	}
+      else
+	for(Direction mu=nDims-1;mu>=0;mu--)
+	  {
+	    coords[mu]=site%sizes[mu];
+	    site/=sizes[mu];
+	  }
       
       return coords;
     }
@@ -156,6 +336,13 @@ namespace maze
       return coordsProvider.coordsOfLx(*this,id);
     }
   };
+  
+  /// Hypercube with sizes known at compile time
+  template <typename Index,
+	    UseHashedCoords UHC,
+	    int...Sizes>
+  using StaticHCube=
+    HCube<sizeof...(Sizes),Index,UHC,Sizes...>;
 }
 
 #endif
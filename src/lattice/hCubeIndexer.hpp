@@ -25,7 +25,7 @@ namespace maze
   {
     /// Number of dimensions
     static constexpr int nDims=
-      HC::NDims;
+      HC::nDims;
     
     /// Reference to the hypercube
     const HC& hCube;
@@ -0,0 +1,251 @@
+#ifndef _HALO_HPP
+#define _HALO_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file halo.hpp
+///
+/// \brief Exchange of the borders of the local lattice among ranks
+///
+/// A field with halo has locVol+haloVol sites: the local ones,
+/// followed by the copies of the sites of the neighboring ranks. The
+/// halo is divided in one block per oriented direction, in order of
+/// orientedDir, each containing the face of the neighbor in that
+/// direction, as laid out by the local grid. Directions which are
+/// fully local have no halo.
+
+#include <array>
+#include <vector>
+
+#include <base/ranks.hpp>
+#include <debug/crasher.hpp>
+#include <lattice/geometry.hpp>
+#include <resources/vector.hpp>
+#include <threads/pool.hpp>
+
+namespace maze
+{
+  /// Halo of the local lattice of a geometry
+  ///
+  /// Holds the list of sites to be sent to each neighbor, and the
+  /// split of the local sites into bulk and surface, such that the
+  /// bulk can be computed while the halo is being received
+  template <typename G>
+  struct Halo
+  {
+    /// Number of dimensions
+    static constexpr int nDims=
+      G::nDims;
+    
+    /// Number of oriented directions
+    static constexpr int nOrientedDirs=
+      G::nOrientedDirs;
+    
+    /// Direction index
+    using Direction=
+      typename G::Direction;
+    
+    /// Local site
+    using LocSite=
+      typename G::LocSite;
+    
+    /// Reference geometry
+    const G& geo;
+    
+    /// Number of sites in the halo of each oriented direction
+    const std::array<LocSite,nOrientedDirs>& haloSizes=
+      geo.locGrid.haloSizes;
+    
+    /// Offset of the halo of each oriented direction, from the end of the local volume
+    const std::array<LocSite,nOrientedDirs>& haloOffsets=
+      geo.locGrid.haloOffsets;
+    
+    /// Total number of sites of the halo
+    const LocSite& haloVol=
+      geo.locGrid.haloVol;
+    
+    /// Local sites to be sent, in the same layout of the halo
+    ///
+    /// Block of oriented direction dir contains the sites sent to
+    /// the neighbor in that direction, ordered as the neighbor
+    /// expects them in its block oppositeDir(dir)
+    Vector<LocSite> sitesToSend;
+    
+    /// Sites whose neighbors are all local
+    Vector<LocSite> bulkSites;
+    
+    /// Sites having at least a neighbor in the halo
+    Vector<LocSite> surfSites;
+    
+    /// Site of the halo in which the face of the neighbor in direction dir is stored, at position i
+    LocSite haloSite(const int& dir,
+		     const LocSite& i) const
+    {
+      return geo.locVol+haloOffsets[dir]+i;
+    }
+    
+    /// Construct from the geometry
+    Halo(const G& geo) :
+      geo(geo),
+      sitesToSend(haloVol),
+      bulkSites(geo.locGrid.bulkVol),
+      surfSites(geo.locVol-geo.locGrid.bulkVol)
+    {
+      /// Number of sites already placed in each block of sites to be sent
+      std::array<LocSite,nOrientedDirs> nPlaced{};
+      
+      /// Number of bulk and surface sites found
+      LocSite nBulk=0,nSurf=0;
+      
+      for(LocSite site=0;site<geo.locVol;site++)
+	{
+	  /// Coordinates of the site
+	  const Coords<nDims> c=
+	    geo.locCoordsOfLocLx(site);
+	  
+	  /// Store whether the site is in the bulk
+	  bool isBulk=true;
+	  
+	  for(int ori=0;ori<2;ori++)
+	    for(Direction mu=0;mu<nDims;mu++)
+	      {
+		/// Oriented direction
+		const int dir=
+		  World<nDims>::orientedDir(ori,mu);
+		
+		if(haloSizes[dir] and c[mu]==(ori?geo.locSizes[mu]-1:0))
+		  {
+		    sitesToSend[haloOffsets[dir]+nPlaced[dir]++]=
+		      site;
+		    
+		    isBulk=false;
+		  }
+	      }
+	  
+	  if(isBulk)
+	    bulkSites[nBulk++]=site;
+	  else
+	    surfSites[nSurf++]=site;
+	}
+      
+      if(nBulk!=geo.locGrid.bulkVol)
+	CRASHER<<"Found "<<nBulk<<" bulk sites, expected "<<geo.locGrid.bulkVol<<endl;
+    }
+    
+    /// Exchange of the halo of a field, in flight until finished
+    ///
+    /// The receptions are posted and the surface packed and sent at
+    /// construction, the communications are completed by finish(),
+    /// or at destruction
+    template <typename T>
+    struct Exchange
+    {
+      /// Reference halo
+      const Halo& halo;
+      
+      /// Buffer where the sites to be sent are packed
+      Vector<T> sendBuf;
+      
+#ifdef USE_MPI
+      /// Pending requests
+      std::vector<MPI_Request> requests;
+#endif
+      
+      /// Start the exchange of the halo of data, which must contain locVol+haloVol sites
+      Exchange(const Halo& halo,
+	       T* data) :
+	halo(halo),
+	sendBuf(halo.haloVol)
+      {
+	if(halo.haloVol==0)
+	  return;
+	
+#ifdef USE_MPI
+	if(halo.geo.ranksGrid.vol!=nRranks())
+	  CRASHER<<"Ranks grid "<<halo.geo.nRanksPerDim<<" does not match the number of ranks "<<nRranks()<<endl;
+	
+	requests.reserve(2*nOrientedDirs);
+	
+	// Post the receptions, tagged with the block they fill
+	for(int dir=0;dir<nOrientedDirs;dir++)
+	  if(halo.haloSizes[dir])
+	    MPI_Irecv(data+halo.haloSite(dir,0),halo.haloSizes[dir]*sizeof(T),MPI_BYTE,
+		      halo.geo.rankNeighs[dir],dir,MPI_COMM_WORLD,&requests.emplace_back());
+	
+	// Pack the surface
+	ThreadPool::loopSplit((int64_t)0,(int64_t)halo.haloVol,
+			      [data,sendBuf=sendBuf.data,sitesToSend=halo.sitesToSend.data](const int64_t& i)
+			      {
+				sendBuf[i]=data[sitesToSend[i]];
+			      });
+	
+	// Send each block, to be stored by the neighbor in the opposite block
+	for(int dir=0;dir<nOrientedDirs;dir++)
+	  if(halo.haloSizes[dir])
+	    MPI_Isend(sendBuf.data+halo.haloOffsets[dir],halo.haloSizes[dir]*sizeof(T),MPI_BYTE,
+		      halo.geo.rankNeighs[dir],World<nDims>::oppositeDir(dir),MPI_COMM_WORLD,&requests.emplace_back());
+#else
+	CRASHER<<"Exchanging the halo requires MPI"<<endl;
+#endif
+      }
+      
+      /// Wait that all communications are completed
+      void finish()
+      {
+#ifdef USE_MPI
+	MPI_Waitall(requests.size(),requests.data(),MPI_STATUSES_IGNORE);
+	
+	requests.clear();
+#endif
+      }
+      
+      /// Complete the communications
+      ~Exchange()
+      {
+	finish();
+      }
+      
+      /// Forbids copy, the communications refer to the buffer
+      Exchange(const Exchange&)=delete;
+    };
+    
+    /// Start the exchange of the halo of data, which must contain locVol+haloVol sites
+    template <typename T>
+    Exchange<T> startExchange(T* data) const
+    {
+      return Exchange<T>(*this,data);
+    }
+    
+    /// Exchange the halo of data, computing f on all local sites
+    ///
+    /// \a f is called on the bulk sites while the halo is in flight,
+    /// then on the surface sites, once the halo is received
+    template <typename T,
+	      typename F>
+    void computeOverlappingExchange(T* data, ///< Field, with locVol+haloVol sites
+				    F&& f)   ///< Function to be called on each local site
+      const
+    {
+      /// Exchange in flight
+      Exchange<T> exchange(*this,data);
+      
+      ThreadPool::loopSplit((int64_t)0,(int64_t)bulkSites.size(),
+			    [&f,bulkSites=bulkSites.data](const int64_t& i)
+			    {
+			      f(bulkSites[i]);
+			    });
+      
+      exchange.finish();
+      
+      ThreadPool::loopSplit((int64_t)0,(int64_t)surfSites.size(),
+			    [&f,surfSites=surfSites.data](const int64_t& i)
+			    {
+			      f(surfSites[i]);
+			    });
+    }
+  };
+}
+
+#endif
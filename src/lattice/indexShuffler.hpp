@@ -36,7 +36,9 @@ namespace maze
     /// Stores the lookup table
     LookupTable lookupTable;
     
-    /// Constructor taking size and filler
+    /// Fills the lookup table with the filler, splitting the work among the threads
+    ///
+    /// f must be callable concurrently on different inputs
     template <typename F,
 	      ENABLE_THIS_TEMPLATE_IF(std::is_invocable_v<F,In> and
 	      			      std::is_convertible_v<std::invoke_result_t<F,In>,Out>)>
@@ -46,10 +48,10 @@ namespace maze
       using Index=
 	typename LookupTable::Index;
       
-      loopOnAllComponentsValues(lookupTable,[this,&f](const Index& i,const In& in)
-					    {
-					      lookupTable(in)=f(in);
-					    });
+      parallelLoopOnAllComponentsValues(lookupTable,[this,&f](const Index&,const In& in)
+						    {
+						      lookupTable(in)=f(in);
+						    });
     }
     
     /// Constructor taking size and filler
@@ -70,6 +72,12 @@ namespace maze
     {
     }
     
+    /// Constructor taking ownership of the vector
+    explicit IndexShuffler(LookupTable&& lookupTable) :
+      lookupTable(std::move(lookupTable))
+    {
+    }
+    
     /// Move constructor
     IndexShuffler(IndexShuffler&& oth) :
       lookupTable(std::move(oth.lookupTable))
@@ -98,9 +106,10 @@ namespace maze
       return *this;
     }
     
-    /// Default constructor
-    IndexShuffler(const In& inMax) :
-      lookupTable(inMax)
+    /// Constructor taking the sizes of the dynamic components of In
+    template <typename...D>
+    IndexShuffler(const TensorComps<D...>& dynSizes) :
+      lookupTable(dynSizes)
     {
     }
     
@@ -138,22 +147,25 @@ namespace maze
 					    });
     }
     
-    /// Returns the transpose shuffler
-    IndexShuffler<Out,In> transpose(const Out& initSizes) const
+    /// Returns the transpose shuffler, given the sizes of the dynamic components of Out
+    template <typename...D>
+    IndexShuffler<Out,In> transpose(const TensorComps<D...>& initSizes) const
     {
       /// Result
       Tensor<Out,In> res(initSizes);
       
-      loopOnAllComponentsValues(lookupTable,[this,&res](const LookupIndex& i,
-							const In& in)
-					    {
-					      /// Take not of the ouutput
-					      const Out out=(*this)(in);
-					      
-					      res(out)=in;
-					    });
+      // Each output is written by a single input, if the shuffler is a permutation
+      parallelLoopOnAllComponentsValues(lookupTable,[this,&res](const LookupIndex&,
+								const In& in)
+						    {
+						      /// Take not of the ouutput
+						      const Out out=(*this)(in);
+						      
+						      res(out)=in;
+						    });
       
-      return static_cast<IndexShuffler<Out,In>>(res);
+      // Moved, to avoid the deep copy of the tensor
+      return IndexShuffler<Out,In>(std::move(res));
     }
   };
 }
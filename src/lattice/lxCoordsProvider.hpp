@@ -7,13 +7,24 @@
 
 /// \file lxCoordsProvider.hpp
 
+#include <array>
+#include <cstdint>
+
+#include <debug/crasher.hpp>
 #include <lattice/coords.hpp>
 #include <resources/vector.hpp>
+#include <threads/pool.hpp>
+#include <unroll/unrolledFor.hpp>
 
 namespace maze
 {
   /// Options for lookup-table usage
-  enum UseHashedCoords{HASHED,NOT_HASHED};
+  ///
+  /// FAST_DIVIDE computes the coordinates without table, replacing
+  /// the divisions by the sizes with multiplications by precomputed
+  /// reciprocals. HASHED_PACKED keeps a table in which the
+  /// coordinates of each site are packed in a single 32-bit word
+  enum UseHashedCoords{HASHED,NOT_HASHED,FAST_DIVIDE,HASHED_PACKED};
   
   /// Uses a lookup table for the coordinates
   template <int _NDims,
@@ -43,6 +54,90 @@ namespace maze
     }
   };
   
+  /// Uses a lookup table of the coordinates packed into a word
+  ///
+  /// Each coordinate takes the number of bits needed to store the
+  /// size of its direction minus one
+  template <int _NDims,
+	    typename Index>
+  struct LxCoordsPackedLookupTable
+  {
+    /// Number of dimensions
+    static constexpr int nDims=
+      _NDims;
+    
+    /// Type of the word holding the coordinates of a site
+    using Word=
+      uint32_t;
+    
+    /// Position of the lowest bit of each coordinate in the word
+    std::array<int,nDims> shifts;
+    
+    /// Mask selecting the bits of each coordinate, once shifted
+    std::array<Word,nDims> masks;
+    
+    /// Lookup table of packed coordinates
+    Vector<Word> packedCoordsOfLxTable;
+    
+    /// Constructor
+    template <typename HC>
+    LxCoordsPackedLookupTable(HC&& grid) :
+      packedCoordsOfLxTable(grid.computeVol())
+    {
+      /// Number of bits used so far
+      int nBits=0;
+      
+      for(int mu=nDims-1;mu>=0;mu--)
+	{
+	  /// Number of bits of the direction
+	  int b=0;
+	  while((1<<b)<grid.sizes[mu])
+	    b++;
+	  
+	  shifts[mu]=nBits;
+	  masks[mu]=(Word)(((uint64_t)1<<b)-1);
+	  nBits+=b;
+	}
+      
+      if(nBits>(int)sizeof(Word)*8)
+	CRASHER<<"Coordinates of sizes "<<grid.sizes<<" need "<<nBits<<" bits, more than the "<<sizeof(Word)*8<<" of the packed table"<<endl;
+      
+      ThreadPool::loopSplit((int64_t)0,(int64_t)grid.computeVol(),
+			    [this,&grid](const int64_t& site)
+			    {
+			      /// Coordinates to be packed
+			      const Coords<nDims> c=
+				grid.computeCoordsOfLx(site);
+			      
+			      /// Packed coordinates
+			      Word w=0;
+			      for(int mu=0;mu<nDims;mu++)
+				w|=(Word)c[mu]<<shifts[mu];
+			      
+			      packedCoordsOfLxTable[site]=w;
+			    });
+    }
+    
+    /// Unpack data from the lookup table
+    template <typename HC>
+    INLINE_FUNCTION Coords<nDims> coordsOfLx(HC&& grid,
+					     const Index& id) const
+    {
+      /// Packed coordinates
+      const Word w=
+	packedCoordsOfLxTable[id];
+      
+      /// Result coordinates
+      Coords<nDims> coords;
+      
+      UNROLLED_FOR(mu,nDims)
+	coords[mu]=(w>>shifts[mu])&masks[mu];
+      UNROLLED_FOR_END;
+      
+      return coords;
+    }
+  };
+  
   /// Do not hold the lookup table
   template <int _NDims,
 	    typename Index>
@@ -67,12 +162,93 @@ namespace maze
     }
   };
   
+  /// Computes the coordinates dividing by the sizes through multiplications
+  ///
+  /// For each size d, with 2^(s-1)<d<=2^s, the reciprocal
+  /// m=ceil(2^(31+s)/d) is stored, such that the quotient of any n
+  /// smaller than 2^31 is (n*m)>>(31+s), which fits 64 bits
+  template <int _NDims,
+	    typename Index>
+  struct LxCoordsFastDivide
+  {
+    /// Number of dimensions
+    static constexpr int nDims=
+      _NDims;
+    
+    /// Number of bits of the dividend
+    static constexpr int nBits=
+      31;
+    
+    /// Size of each direction
+    std::array<uint64_t,nDims> sizes;
+    
+    /// Reciprocal of the size of each direction
+    std::array<uint64_t,nDims> reciprocals;
+    
+    /// Shift to be applied after multiplying by the reciprocal
+    std::array<int,nDims> shifts;
+    
+    /// Constructor
+    template <typename HC>
+    LxCoordsFastDivide(HC&& grid)
+    {
+      if((int64_t)grid.computeVol()>=((int64_t)1<<nBits))
+	CRASHER<<"Volume "<<grid.computeVol()<<" of sizes "<<grid.sizes<<" too large for the fast division"<<endl;
+      
+      for(int mu=0;mu<nDims;mu++)
+	{
+	  sizes[mu]=grid.sizes[mu];
+	  
+	  /// Number of bits needed to store sizes-1
+	  int s=0;
+	  while(((uint64_t)1<<s)<sizes[mu])
+	    s++;
+	  
+	  shifts[mu]=nBits+s;
+	  reciprocals[mu]=(((uint64_t)1<<shifts[mu])+sizes[mu]-1)/sizes[mu];
+	}
+    }
+    
+    /// Computes
+    template <typename HC>
+    INLINE_FUNCTION Coords<nDims> coordsOfLx(HC&& /*grid*/,
+					     const Index& id) const
+    {
+      /// Result coordinates
+      Coords<nDims> coords;
+      
+      /// Residual index
+      uint64_t site=id;
+      
+      // Unrolled, so that the quotients of different sites can overlap
+      UNROLLED_FOR(i,nDims)
+	{
+	  /// Direction, from the fastest
+	  const int mu=
+	    nDims-1-i;
+	  
+	  /// Quotient
+	  const uint64_t q=
+	    (site*reciprocals[mu])>>shifts[mu];
+	  
+	  coords[mu]=site-q*sizes[mu];
+	  site=q;
+	}
+      UNROLLED_FOR_END;
+      
+      return coords;
+    }
+  };
+  
   /// Use or not the lookup table
   template <int NDim,
 	    typename Index,
 	    UseHashedCoords UHC>
   using HashedOrNotLxCoords=
-    std::conditional_t<UHC==HASHED,LxCoordsLookupTable<NDim,Index>,LxCoordsNoLookupTable<NDim,Index>>;
+    std::conditional_t<UHC==HASHED,LxCoordsLookupTable<NDim,Index>,
+		       std::conditional_t<UHC==FAST_DIVIDE,LxCoordsFastDivide<NDim,Index>,
+					  std::conditional_t<UHC==HASHED_PACKED,LxCoordsPackedLookupTable<NDim,Index>,
+							     LxCoordsNoLookupTable<NDim,Index>>>>;
 }
 
 #endif
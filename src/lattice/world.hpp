@@ -26,6 +26,19 @@ namespace maze
       2*nDims;
     
     DECLARE_COMPONENT(Direction,int,nDims,direction);
+    
+    /// Index of the oriented direction, backward (ori=0) or forward (ori=1) along mu
+    static constexpr int orientedDir(const int& ori,
+				     const int& mu)
+    {
+      return mu+nDims*ori;
+    }
+    
+    /// Oriented direction opposite to the passed one
+    static constexpr int oppositeDir(const int& dir)
+    {
+      return (dir+nDims)%nOrientedDirs;
+    }
   };
 }
 
@@ -0,0 +1,57 @@
+#ifndef _CACHE_SIZES_HPP
+#define _CACHE_SIZES_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file cacheSizes.hpp
+///
+/// \brief Sizes of the cache levels of the host
+
+#include <cstdint>
+#include <unistd.h>
+
+namespace maze
+{
+  /// Size of the L2 cache in bytes, as reported by the system
+  ///
+  /// If the system does not report it, a conservative 256 KiB is
+  /// returned
+  inline int64_t l2CacheSize()
+  {
+    /// Size reported by the system, zero or negative if unknown
+    static const int64_t reported=
+#ifdef _SC_LEVEL2_CACHE_SIZE
+      sysconf(_SC_LEVEL2_CACHE_SIZE);
+#else
+      0;
+#endif
+    
+    if(reported>0)
+      return reported;
+    else
+      return 1<<18;
+  }
+  
+  /// Size of the last level cache in bytes, as reported by the system
+  ///
+  /// The L3 cache is taken if reported, the L2 cache otherwise
+  inline int64_t llcSize()
+  {
+    /// Size reported by the system, zero or negative if unknown
+    static const int64_t reported=
+#ifdef _SC_LEVEL3_CACHE_SIZE
+      sysconf(_SC_LEVEL3_CACHE_SIZE);
+#else
+      0;
+#endif
+    
+    if(reported>0)
+      return reported;
+    else
+      return l2CacheSize();
+  }
+}
+
+#endif
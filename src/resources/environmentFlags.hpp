@@ -28,6 +28,7 @@
 #include <tuple>
 
 #include <debug/gdbAttach.hpp>
+#include <resources/memoryManager.hpp>
 #include <threads/pool.hpp>
 
 namespace maze
@@ -38,8 +39,17 @@ namespace maze
   
   /// List of known flags
   FLAG_LIST(std::make_tuple(std::make_tuple(&waitToAttachDebuggerFlag,false,"WAIT_TO_ATTACH_DEBUGGER","to be used to wait for gdb to attach")
+			    ,std::make_tuple(&memorySizeClassBits,2,"MEMORY_SIZE_CLASS_BITS","number of bits splitting each power of two into memory size classes")
+			    ,std::make_tuple(&hugePagesMode,(int)NO_HUGE_PAGES,"HUGE_PAGES_MODE","huge pages for large allocations: 0 none, 1 transparent, 2 explicitly reserved")
+			    ,std::make_tuple(&parallelFirstTouch,false,"PARALLEL_FIRST_TOUCH","to be used to touch newly allocated memory in parallel, as split loops do")
+			    ,std::make_tuple(&maxThreadCachedBlocks,(int64_t)16,"MAX_THREAD_CACHED_BLOCKS","maximal number of memory blocks of each size class cached by each thread")
 #ifdef USE_THREADS
 			    ,std::make_tuple(&useDetachedPool,false,"USE_DETACHED_POOL","to be used to create a pool at the begin")
+			    ,std::make_tuple(&ThreadPool::parallelAssignThreshold,(int64_t)32768,"PARALLEL_ASSIGN_THRESHOLD","minimal number of elements for which an assignment is split among threads")
+			    ,std::make_tuple(&ThreadPool::parallelCopyThreshold,(int64_t)(1<<18),"PARALLEL_COPY_THRESHOLD","minimal number of bytes for which a copy is split among threads")
+			    ,std::make_tuple(&ThreadPool::loopSchedule,(int)ThreadPool::STATIC,"LOOP_SCHEDULE","schedule of split loops: 0 static, 1 dynamic, 2 guided")
+			    ,std::make_tuple(&ThreadPool::loopChunkSize,(int64_t)16,"LOOP_CHUNK_SIZE","number of iterations taken at once (at least, for guided) by dynamic schedules")
+			    ,std::make_tuple(&ThreadPool::poolSpinIterations,(int64_t)(1<<16),"POOL_SPIN_ITERATIONS","number of iterations a thread spins waiting for work before sleeping")
 #endif
 			    ));
   
@@ -9,7 +9,14 @@
 ///
 /// \brief Main manager for GPU and CPU memory
 
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <unordered_map>
 #include <vector>
 
 #ifdef USE_CUDA
@@ -23,7 +30,7 @@
 #include <metaProgramming/nonConstMethod.hpp>
 #include <resources/storLoc.hpp>
 #include <threads/pool.hpp>
-#include <utilities/valueWithExtreme.hpp>
+#include <threads/spinLock.hpp>
 
 namespace maze
 {
@@ -46,7 +53,57 @@ namespace maze
   /// Minimal alignment
 #define DEFAULT_ALIGNMENT 64
   
+  /// Number of bits used to split each power of two into size classes
+  ///
+  /// Blocks are rounded up to the next of the 2^bits sizes evenly
+  /// spaced within each power of two, so that at most a fraction
+  /// 1/2^bits of the memory is wasted
+  EXTERN_MEMORY_MANAGER int memorySizeClassBits INIT_MEMORY_MANAGER_TO(2);
+  
+  /// Maximal number of blocks of each size class cached by each thread
+  ///
+  /// Further blocks are moved to the cache shared among all threads
+  EXTERN_MEMORY_MANAGER int64_t maxThreadCachedBlocks INIT_MEMORY_MANAGER_TO(16);
+  
+  /// Possible ways to use huge pages
+  enum HugePagesMode{NO_HUGE_PAGES,          ///< Use normal pages
+		     TRANSPARENT_HUGE_PAGES, ///< Advise the kernel to use transparent huge pages
+		     EXPLICIT_HUGE_PAGES     ///< Map explicitly reserved huge pages
+  };
+  
+  /// Mode to be used for huge pages, one of HugePagesMode
+  EXTERN_MEMORY_MANAGER int hugePagesMode INIT_MEMORY_MANAGER_TO(NO_HUGE_PAGES);
+  
+  /// Touch in parallel the newly allocated memory
+  EXTERN_MEMORY_MANAGER bool parallelFirstTouch INIT_MEMORY_MANAGER_TO(false);
+  
+  /// Header describing a block provided by the memory manager
+  struct MemoryBlockHeader
+  {
+    /// Pointer returned by the raw allocation
+    void* raw;
+    
+    /// Size of the raw allocation
+    Size rawSize;
+    
+    /// Size class of the block
+    int sizeClass;
+  };
+  
   /// Memory manager, base type
+  ///
+  /// Memory is provided in blocks whose size is rounded up to a size
+  /// class. Released blocks are cached in a list per size class,
+  /// private to the releasing thread up to maxThreadCachedBlocks,
+  /// and shared among all threads beyond it. Provide and release
+  /// are thus O(1) and can be called from inside the thread pool,
+  /// the shared lists being protected by a spin lock.
+  ///
+  /// The size class of each block is kept in a header, whose
+  /// storage is delegated to the derived class.
+  ///
+  /// No logging is done when providing or releasing, since it would
+  /// dominate the cost and race among threads
   template <typename C>
   class BaseMemoryManager
   {
@@ -55,73 +112,128 @@ namespace maze
   protected:
     
     /// Number of allocation performed
-    Size nAlloc{0};
+    std::atomic<Size> nAlloc{0};
     
   private:
     
-    /// List of dynamical allocated memory
-    std::map<void*,Size> used;
+    /// Maximal number of threads which can have their own cache
+    ///
+    /// Further threads directly use the shared cache
+    static constexpr int maxNThreadCaches=
+      256;
+    
+    /// Number of bits splitting each power of two, fixed at creation
+    const int sizeClassBits;
     
-    /// List of cached allocated memory
-    std::map<Size,std::vector<void*>> cached;
+    /// Number of size classes
+    const int nSizeClasses;
+    
+    /// Blocks cached by each thread, for each size class
+    ///
+    /// The list of each thread is only accessed by the thread itself
+    std::vector<std::vector<std::vector<void*>>> threadCached;
+    
+    /// Blocks cached and shared among all threads, for each size class
+    std::vector<std::vector<void*>> sharedCached;
+    
+    /// Lock protecting the shared cache
+    SpinLock sharedCachedLock;
     
     /// Size of used memory
-    ValWithMax<Size> usedSize;
+    std::atomic<Size> usedSize{0};
+    
+    /// Maximal size of used memory
+    std::atomic<Size> maxUsedSize{0};
     
     /// Size of cached memory
-    ValWithMax<Size> cachedSize;
+    std::atomic<Size> cachedSize{0};
+    
+    /// Maximal size of cached memory
+    std::atomic<Size> maxCachedSize{0};
     
     /// Use or not cache
     bool useCache{true};
     
     /// Number of cached memory reused
-    Size nCachedReused{0};
+    std::atomic<Size> nCachedReused{0};
     
-    /// Add to the list of used memory
-    void pushToUsed(void* ptr,
-		    const Size size)
+    /// Increase the value, keeping track of the maximum
+    static void increaseKeepingMax(std::atomic<Size>& val,
+				   std::atomic<Size>& max,
+				   const Size incr)
     {
-      used[ptr]=size;
+      /// Value after the increase
+      const Size newVal=
+	val.fetch_add(incr,std::memory_order_relaxed)+incr;
       
-      usedSize+=size;
+      /// Maximum seen so far
+      Size prevMax=
+	max.load(std::memory_order_relaxed);
       
-      VERB_LOGGER(3)<<"Pushing to used "<<ptr<<" "<<size<<", used: "<<usedSize<<endl;
+      while(prevMax<newVal and not max.compare_exchange_weak(prevMax,newVal,std::memory_order_relaxed));
     }
     
-    /// Removes a pointer from the used list, without actually freeing associated memory
+    /// Slot of the calling thread in the list of thread caches
     ///
-    /// Returns the size of the memory pointed
-    Size popFromUsed(void* ptr) ///< Pointer to the memory to move to cache
+    /// Assigned at first usage, -1 if all slots have been taken
+    static int threadSlot()
     {
-      VERB_LOGGER(3)<<"Popping from used "<<ptr<<endl;
-      
-      /// Iterator to search result
-      auto el=
-	used.find(ptr);
+      /// Number of slots assigned so far
+      static std::atomic<int> nAssignedSlots{0};
       
-      if(el==used.end())
-	CRASHER<<"Unable to find dinamically allocated memory "<<ptr<<endl;
+      /// Slot of the thread
+      thread_local const int slot=
+	[]()
+	{
+	  /// Slot to be tried
+	  const int tentativeSlot=
+	    nAssignedSlots.fetch_add(1);
+	  
+	  return
+	    (tentativeSlot<maxNThreadCaches)?tentativeSlot:-1;
+	}();
       
-      /// Size of memory
-      const Size size=el->second;
+      return
+	slot;
+    }
+    
+    /// Size class of a block of the given size
+    ///
+    /// The class is identified by the position e of the highest bit
+    /// of size-1 and by the subsequent sizeClassBits bits
+    int sizeClassOf(const Size size)
+      const
+    {
+      /// Size to be rounded, at least as large as the alignment
+      const Size s=
+	std::max(size,(Size)DEFAULT_ALIGNMENT);
       
-      usedSize-=size;
+      /// Position of the highest bit of s-1
+      const int e=
+	63-__builtin_clzl(s-1);
       
-      used.erase(el);
+      /// Leading bits of s-1
+      const Size q=
+	(s-1)>>(e-sizeClassBits);
       
       return
-	size;
+	(e<<sizeClassBits)+q-((Size)1<<sizeClassBits);
     }
     
-    /// Adds a memory to cache
-    void pushToCache(void* ptr,          ///< Memory to cache
-		     const Size size)    ///< Memory size
+    /// Size of the blocks of a given class
+    Size sizeOfClass(const int sizeClass)
+      const
     {
-      cached[size].push_back(ptr);
+      /// Position of the highest bit of size-1
+      const int e=
+	sizeClass>>sizeClassBits;
       
-      cachedSize+=size;
+      /// Leading bits of size-1
+      const Size q=
+	(sizeClass&(((Size)1<<sizeClassBits)-1))+((Size)1<<sizeClassBits);
       
-      VERB_LOGGER(3)<<"Pushing to cache "<<size<<" "<<ptr<<", cache size: "<<cached.size()<<endl;
+      return
+	(q+1)<<(e-sizeClassBits);
     }
     
     /// Check if a pointer is suitably aligned
@@ -132,59 +244,125 @@ namespace maze
 	reinterpret_cast<uintptr_t>(ptr)%alignment==0;
     }
     
-    /// Pop from the cache, returning to use
-    void* popFromCache(const Size& size,
-		       const Size& alignment)
+    /// Pop from the list the latest block, if suitably aligned
+    static void* popFromList(std::vector<void*>& list,
+			     const Size alignment)
     {
-      VERB_LOGGER(3)<<"Try to popping from cache "<<size<<endl;
+      if(list.empty() or not isAligned(list.back(),alignment))
+	return nullptr;
       
-      /// List of memory with searched size
-      auto cachedIt=
-	cached.find(size);
+      /// Returned pointer
+      void* ptr=
+	list.back();
       
-      if(cachedIt==cached.end())
-	return nullptr;
-      else
+      list.pop_back();
+      
+      return
+	ptr;
+    }
+    
+    /// Cached blocks of the given class, private to the thread in the given slot
+    std::vector<void*>& threadCachedList(const int slot,
+					 const int sizeClass)
+    {
+      /// Lists of the thread
+      auto& lists=
+	threadCached[slot];
+      
+      // Only the thread itself can resize its lists
+      if(lists.empty())
+	lists.resize(nSizeClasses);
+      
+      return
+	lists[sizeClass];
+    }
+    
+    /// Adds a block to the cache
+    void pushToCache(void* ptr,          ///< Block to cache
+		     const int sizeClass) ///< Size class of the block
+    {
+      increaseKeepingMax(cachedSize,maxCachedSize,sizeOfClass(sizeClass));
+      
+      if(const int slot=threadSlot();slot>=0)
 	{
-	  /// Vector of pointers
-	  auto& list=cachedIt->second;
+	  /// List of the thread
+	  auto& list=
+	    threadCachedList(slot,sizeClass);
 	  
-	  /// Get latest cached memory with appropriate alignment
-	  auto it=list.end()-1;
-	  
-	  while(it!=list.begin()-1 and not isAligned(*it,alignment))
-	    it--;
-	  
-	  if(it==list.begin()-1)
-	    return nullptr;
-	  else
+	  if((int64_t)list.size()<maxThreadCachedBlocks)
 	    {
-	      /// Returned pointer, copied here before erasing
-	      void* ptr=
-		*it;
-	      
-	      list.erase(it);
-	      
-	      cachedSize-=size;
+	      list.push_back(ptr);
 	      
-	      if(list.size()==0)
-		cached.erase(cachedIt);
-	      
-	      return ptr;
+	      return;
 	    }
 	}
+      
+      std::lock_guard<SpinLock> lock(sharedCachedLock);
+      
+      sharedCached[sizeClass].push_back(ptr);
+    }
+    
+    /// Pop from the cache a block of the given class, nullptr if not found
+    void* popFromCache(const int sizeClass,
+		       const Size alignment)
+    {
+      /// Returned pointer
+      void* ptr=
+	nullptr;
+      
+      if(const int slot=threadSlot();slot>=0)
+	ptr=popFromList(threadCachedList(slot,sizeClass),alignment);
+      
+      if(ptr==nullptr)
+	{
+	  std::lock_guard<SpinLock> lock(sharedCachedLock);
+	  
+	  ptr=popFromList(sharedCached[sizeClass],alignment);
+	}
+      
+      if(ptr!=nullptr)
+	cachedSize.fetch_sub(sizeOfClass(sizeClass),std::memory_order_relaxed);
+      
+      return
+	ptr;
+    }
+    
+    /// Allocate a new block of the given class
+    void* allocateBlock(const int sizeClass,
+			const Size alignment)
+    {
+      /// Room for the header, if stored in front of the block
+      const Size headerSize=
+	C::headerIsInBlock?alignment:0;
+      
+      /// Size of the raw allocation
+      const Size rawSize=
+	sizeOfClass(sizeClass)+headerSize;
+      
+      /// Raw allocated memory
+      void* raw=
+	this->deFeat().allocateRaw(rawSize,alignment);
+      
+      /// Returned pointer, keeping the alignment of the raw one
+      void* ptr=
+	static_cast<char*>(raw)+headerSize;
+      
+      this->deFeat().storeBlockHeader(ptr,{raw,rawSize,sizeClass});
+      
+      return
+	ptr;
     }
     
-    /// Move the allocated memory to cache
-    void moveToCache(void* ptr) ///< Pointer to the memory to move to cache
+    /// Frees a block
+    void deAllocateBlock(void* ptr)
     {
-      VERB_LOGGER(3)<<"Moving to cache "<<ptr<<endl;
+      /// Header of the block, copied before forgetting it
+      const MemoryBlockHeader header=
+	this->deFeat().blockHeader(ptr);
       
-      /// Size of pointed memory
-      const Size size=
-	popFromUsed(ptr);
+      this->deFeat().forgetBlockHeader(ptr);
       
-      pushToCache(ptr,size);
+      this->deFeat().deAllocateRaw(header.raw,header.rawSize);
     }
     
   public:
@@ -209,25 +387,29 @@ namespace maze
     T* provide(const Size nel,
 	       const Size alignment=DEFAULT_ALIGNMENT)
     {
-      /// Total size to allocate
-      const Size size=
-	sizeof(T)*nel;
+      /// Size class of the block to be provided
+      const int sizeClass=
+	sizeClassOf(sizeof(T)*nel);
+      
+      /// Alignment of the block, cached blocks are at least aligned to the default
+      const Size blockAlignment=
+	std::max(alignment,(Size)DEFAULT_ALIGNMENT);
       
       /// Allocated memory
-      void* ptr;
+      void* ptr=
+	nullptr;
       
       // Search in the cache
-      ptr=
-	popFromCache(size,alignment);
+      if(useCache)
+	ptr=popFromCache(sizeClass,blockAlignment);
       
       // If not found in the cache, allocate new memory
       if(ptr==nullptr)
-	ptr=
-	  this->deFeat().allocateRaw(size,alignment);
+	ptr=allocateBlock(sizeClass,blockAlignment);
       else
 	nCachedReused++;
       
-      pushToUsed(ptr,size);
+      increaseKeepingMax(usedSize,maxUsedSize,sizeOfClass(sizeClass));
       
       return static_cast<T*>(ptr);
     }
@@ -238,105 +420,93 @@ namespace maze
     {
       if(ptr!=nullptr)
 	{
-	  ThreadPool::waitThatAllWorkersWaitForWork();
+	  /// Pointer to the block
+	  void* block=
+	    static_cast<void*>(ptr);
+	  
+	  /// Size class of the block
+	  const int sizeClass=
+	    this->deFeat().blockHeader(block).sizeClass;
+	  
+	  usedSize.fetch_sub(sizeOfClass(sizeClass),std::memory_order_relaxed);
 	  
 	  if(useCache)
-	    moveToCache(static_cast<void*>(ptr));
+	    pushToCache(block,sizeClass);
 	  else
-	    {
-	      popFromUsed(ptr);
-	      this->deFeat().deAllocateRaw(static_cast<void*>(ptr));
-	    }
+	    deAllocateBlock(block);
 	  
 	  ptr=
 	    nullptr;
 	}
     }
     
-    /// Release all used memory
-    void releaseAllUsedMemory()
-    {
-      /// Iterator on elements to release
-      auto el=
-	used.begin();
-      
-      while(el!=used.end())
-	{
-	  VERB_LOGGER(3)<<"Releasing "<<el->first<<" size "<<el->second<<endl;
-	  
-	  /// Pointer to memory to release
-	  void* ptr=el->first;
-	  
-	  // Increment iterator before releasing
-	  el++;
-	  
-	  this->deFeat().release(ptr);
-	}
-    }
-    
     /// Release all memory from cache
+    ///
+    /// The caches of all threads are cleared, so this cannot be
+    /// called while other threads are providing or releasing memory
     void clearCache()
     {
       VERB_LOGGER(3)<<"Clearing cache"<<endl;
       
-      /// Iterator to elements of the cached memory list
-      auto el=
-	cached.begin();
-      
-      while(el!=cached.end())
+      /// Free all blocks of a list
+      auto clearList=
+	[this](std::vector<void*>& list)
 	{
-	  /// Number of elements to free
-	  const Size n=
-	    el->second.size();
-	  
-	  /// Size to be removed
-	  const Size size=
-	    el->first;
+	  for(void* ptr : list)
+	    deAllocateBlock(ptr);
 	  
-	  // Increment before erasing
-	  el++;
-	  
-	  for(Size i=0;i<n;i++)
-	    {
-	      VERB_LOGGER(3)<<"Removing from cache size  "<<el->first<<endl;
-	      
-	      /// Memory to free
-	      void* ptr=
-		popFromCache(size,DEFAULT_ALIGNMENT);
-	      
-	      VERB_LOGGER(3)<<"ptr: "<<ptr<<endl;
-	      this->deFeat().deAllocateRaw(ptr);
-	    }
-	}
+	  list.clear();
+	};
+      
+      for(auto& lists : threadCached)
+	for(auto& list : lists)
+	  clearList(list);
+      
+      for(auto& list : sharedCached)
+	clearList(list);
+      
+      cachedSize=0;
     }
     
     /// Print to a stream
     void printStatistics()
     {
       LOGGER<<
-	"Maximal memory used: "<<usedSize.extreme()<<" bytes, "
-	"currently used: "<<(Size)usedSize<<" bytes, "
-	"maxcached: "<<cachedSize.extreme()<<" bytes, "
-	"currently cached: "<<(Size)cachedSize<<" bytes, "
+	"Maximal memory used: "<<maxUsedSize<<" bytes, "
+	"currently used: "<<usedSize<<" bytes, "
+	"maxcached: "<<maxCachedSize<<" bytes, "
+	"currently cached: "<<cachedSize<<" bytes, "
 	"number of reused: "<<nCachedReused<<endl;
     }
     
     /// Create the memory manager
     BaseMemoryManager() :
-      usedSize(0),
-      cachedSize(0)
+      sizeClassBits(memorySizeClassBits),
+      nSizeClasses(64<<sizeClassBits),
+      threadCached(maxNThreadCaches),
+      sharedCached(nSizeClasses)
     {
       LOGGER<<"Starting the memory manager"<<endl;
+      
+      // The class of the minimal block must be computable: its
+      // highest bit e, that of DEFAULT_ALIGNMENT-1, must be at least
+      // sizeClassBits, not to shift by e-sizeClassBits<0
+      if(sizeClassBits<0 or ((Size)2<<sizeClassBits)>DEFAULT_ALIGNMENT)
+	CRASHER<<"Number of size class bits "<<sizeClassBits<<" must be in the range [0,"<<__builtin_ctz(DEFAULT_ALIGNMENT)-1<<"]"<<endl;
     }
     
     /// Destruct the memory manager
+    ///
+    /// Memory still in use cannot be freed, since it has not been
+    /// tracked, and will be returned to the system at exit
     ~BaseMemoryManager()
     {
       LOGGER<<"Stopping the memory manager"<<endl;
       
       printStatistics();
       
-      releaseAllUsedMemory();
+      if(usedSize!=0)
+	LOGGER<<"Warning, "<<usedSize<<" bytes still in use"<<endl;
       
       clearCache();
     }
@@ -345,33 +515,149 @@ namespace maze
   /// Manager of CPU memory
   struct CPUMemoryManager : public BaseMemoryManager<CPUMemoryManager>
   {
+    /// Size of huge pages
+    ///
+    /// Only allocations at least this large are backed by huge pages
+    static constexpr Size hugePageSize=
+      1<<21;
+    
+    /// Size of the allocation rounded up to huge pages
+    static Size roundUpToHugePages(const Size size)
+    {
+      return
+	(size+hugePageSize-1)/hugePageSize*hugePageSize;
+    }
+    
+    /// Determine whether an allocation is backed by explicit huge pages
+    static bool usesExplicitHugePages(const Size size)
+    {
+      return
+	hugePagesMode==EXPLICIT_HUGE_PAGES and
+	size>=hugePageSize;
+    }
+    
+    /// Determine whether an allocation is advised to be backed by transparent huge pages
+    static bool usesTransparentHugePages(const Size size)
+    {
+      return
+	hugePagesMode==TRANSPARENT_HUGE_PAGES and
+	size>=hugePageSize;
+    }
+    
+    /// Touch the memory for the first time, in parallel
+    ///
+    /// The memory is split among threads as loopSplit would do, so
+    /// that the pages are placed on the NUMA node of the thread
+    /// which will access them in a split loop
+    static void firstTouch([[maybe_unused]] void* ptr,        ///< Memory to touch
+			   [[maybe_unused]] const Size size)  ///< Size of the memory
+    {
+#ifdef USE_THREADS
+      /// Size of the pages
+      static const Size pageSize=
+	sysconf(_SC_PAGESIZE);
+      
+      // A parallel section can only be opened by the master, outside other ones
+      if(not ThreadPool::poolIsStarted or
+	 ThreadPool::isInsideParallelSection() or
+	 size<nThreads*pageSize)
+	return;
+      
+      ThreadPool::parallel([ptr,size](const int& threadId)
+			   {
+			     /// Chunk of this thread
+			     const auto [beg,end]=
+			       ThreadPool::chunkOfThread((Size)0,size,nThreads,threadId);
+			     
+			     memset(static_cast<char*>(ptr)+beg,0,end-beg);
+			   });
+#endif
+    }
+    
     /// Get memory
     ///
-    /// Call the system routine which allocate memory
+    /// Call the system routine which allocate memory, possibly
+    /// backed by huge pages, and touch it in parallel if asked
     void* allocateRaw(const Size size,        ///< Amount of memory to allocate
 		      const Size alignment)   ///< Required alignment
     {
       /// Result
       void* ptr=nullptr;
       
-      /// Returned condition
       VERB_LOGGER(3)<<"Allocating size "<<size<<" on CPU"<<endl;
-      int rc=
-	posix_memalign(&ptr,alignment,size);
-      if(rc)
-	CRASHER<<"Failed to allocate "<<size<<" CPU memory with alignement "<<alignment<<endl;
+      
+      if(usesExplicitHugePages(size))
+	{
+	  ptr=
+	    mmap(nullptr,roundUpToHugePages(size),PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB,-1,0);
+	  
+	  if(ptr==MAP_FAILED)
+	    CRASHER<<"Failed to allocate "<<size<<" CPU memory on explicit huge pages, check that enough are reserved in /proc/sys/vm/nr_hugepages"<<endl;
+	}
+      else
+	{
+	  /// Use transparent huge pages
+	  const bool useTransparent=
+	    usesTransparentHugePages(size);
+	  
+	  /// Actual alignment, to huge pages if used
+	  const Size actualAlignment=
+	    useTransparent?std::max(alignment,hugePageSize):alignment;
+	  
+	  /// Returned condition
+	  int rc=
+	    posix_memalign(&ptr,actualAlignment,size);
+	  if(rc)
+	    CRASHER<<"Failed to allocate "<<size<<" CPU memory with alignement "<<actualAlignment<<endl;
+	  
+	  // Failing to advise is not an error, the memory is simply backed by normal pages
+	  if(useTransparent and madvise(ptr,size,MADV_HUGEPAGE))
+	    VERB_LOGGER(3)<<"Unable to advise the usage of transparent huge pages"<<endl;
+	}
       VERB_LOGGER(3)<<"ptr: "<<ptr<<endl;
       
+      if(parallelFirstTouch)
+	firstTouch(ptr,size);
+      
       nAlloc++;
       
       return ptr;
     }
     
     /// Properly free
-    void deAllocateRaw(void* ptr)
+    void deAllocateRaw(void* ptr,
+		       const Size size)
     {
       VERB_LOGGER(3)<<"Freeing from CPU memory "<<ptr<<endl;
-      free(ptr);
+      
+      if(usesExplicitHugePages(size))
+	munmap(ptr,roundUpToHugePages(size));
+      else
+	free(ptr);
+    }
+    
+    /// Header is stored in front of each block
+    static constexpr bool headerIsInBlock=
+      true;
+    
+    /// Header of the block
+    static MemoryBlockHeader& blockHeader(void* ptr)
+    {
+      return
+	static_cast<MemoryBlockHeader*>(ptr)[-1];
+    }
+    
+    /// Store the header of the block
+    static void storeBlockHeader(void* ptr,
+				 const MemoryBlockHeader& header)
+    {
+      blockHeader(ptr)=
+	header;
+    }
+    
+    /// Nothing to be done to forget the header, freed with the block
+    static void forgetBlockHeader(void*)
+    {
     }
   };
   
@@ -402,11 +688,56 @@ namespace maze
     }
     
     /// Properly free
-    void deAllocateRaw(void* ptr)
+    void deAllocateRaw(void* ptr,
+		       const Size size)
     {
       VERB_LOGGER(3)<<"Freeing from GPU memory "<<ptr<<endl;
       DECRYPT_CUDA_ERROR(cudaFree(ptr),"Freeing from GPU");
     }
+    
+    /// Headers cannot be stored in device memory
+    static constexpr bool headerIsInBlock=
+      false;
+    
+    /// Headers of all blocks
+    std::unordered_map<void*,MemoryBlockHeader> headers;
+    
+    /// Lock protecting the headers
+    SpinLock headersLock;
+    
+    /// Header of the block
+    MemoryBlockHeader blockHeader(void* ptr)
+    {
+      std::lock_guard<SpinLock> lock(headersLock);
+      
+      /// Iterator to search result
+      auto el=
+	headers.find(ptr);
+      
+      if(el==headers.end())
+	CRASHER<<"Unable to find dinamically allocated memory "<<ptr<<endl;
+      
+      return
+	el->second;
+    }
+    
+    /// Store the header of the block
+    void storeBlockHeader(void* ptr,
+			  const MemoryBlockHeader& header)
+    {
+      std::lock_guard<SpinLock> lock(headersLock);
+      
+      headers[ptr]=
+	header;
+    }
+    
+    /// Forget the header of the block
+    void forgetBlockHeader(void* ptr)
+    {
+      std::lock_guard<SpinLock> lock(headersLock);
+      
+      headers.erase(ptr);
+    }
   };
   
   /// Memory manager for gpu
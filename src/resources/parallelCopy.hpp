@@ -0,0 +1,391 @@
+#ifndef _PARALLEL_COPY_HPP
+#define _PARALLEL_COPY_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file parallelCopy.hpp
+///
+/// \brief Copy and fill of memory split among the threads
+///
+/// When the destination exceeds the last level cache, the stores
+/// are non-temporal, so that they do not evict useful data nor read
+/// the destination before writing it.
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if defined __SSE2__ and not defined DISABLE_X86_INTRINSICS
+# include <immintrin.h>
+#endif
+
+#include <resources/cacheSizes.hpp>
+#include <threads/pool.hpp>
+
+namespace maze
+{
+  namespace resources
+  {
+    /// Size of the pieces in which a parallel copy is split
+    constexpr int64_t PARALLEL_COPY_PIECE_SIZE=
+      1<<16;
+    
+    /// Side of the square tiles in which a permuted copy is blocked
+    constexpr int64_t PERMUTED_COPY_TILE_SIZE=
+      32;
+    
+    /// Stores size bytes to dst, non-temporally if possible
+    ///
+    /// The function f(dst,n) stores n bytes with ordinary stores,
+    /// g(dst,i) stores 16 bytes at the i-th aligned position of dst.
+    /// The non-temporal stores are fenced by the calling thread, which
+    /// issued them, before returning
+    template <typename F,
+	      typename G>
+    void streamingStore(char* dst,
+			const int64_t& size,
+			F&& f,
+			G&& g)
+    {
+#if defined __SSE2__ and not defined DISABLE_X86_INTRINSICS
+      /// Bytes to be stored before reaching the alignment
+      const int64_t head=
+	std::min(size,(int64_t)((16-(uintptr_t)dst%16)%16));
+      
+      f(dst,head);
+      
+      /// Number of aligned 16 bytes stores
+      const int64_t nVecs=
+	(size-head)/16;
+      
+      for(int64_t i=0;i<nVecs;i++)
+	g(dst+head,i);
+      
+      f(dst+head+nVecs*16,size-head-nVecs*16);
+      
+      // Order the non-temporal stores before the subsequent ones,
+      // such as those signaling the completion of the work
+      _mm_sfence();
+#else
+      f(dst,size);
+#endif
+    }
+    
+    /// Copies size bytes from src to dst
+    inline void memcpyPiece(char* dst,
+			    const char* src,
+			    const int64_t& size,
+			    const bool& nonTemporal)
+    {
+#if defined __SSE2__ and not defined DISABLE_X86_INTRINSICS
+      if(nonTemporal)
+	{
+	  streamingStore(dst,size,
+			 [dst,src](char* d,const int64_t& n)
+			 {
+			   memcpy(d,src+(d-dst),n);
+			 },
+			 [dst,src](char* d,const int64_t& i)
+			 {
+			   _mm_stream_si128((__m128i*)d+i,_mm_loadu_si128((const __m128i*)(src+(d-dst))+i));
+			 });
+	  
+	  return;
+	}
+#endif
+      
+      memcpy(dst,src,size);
+    }
+    
+    /// Sets size bytes of dst to c
+    inline void memsetPiece(char* dst,
+			    const char& c,
+			    const int64_t& size,
+			    const bool& nonTemporal)
+    {
+#if defined __SSE2__ and not defined DISABLE_X86_INTRINSICS
+      if(nonTemporal)
+	{
+	  /// Vector filled with c
+	  const __m128i v=
+	    _mm_set1_epi8(c);
+	  
+	  streamingStore(dst,size,
+			 [c](char* d,const int64_t& n)
+			 {
+			   memset(d,c,n);
+			 },
+			 [v](char* d,const int64_t& i)
+			 {
+			   _mm_stream_si128((__m128i*)d+i,v);
+			 });
+	  
+	  return;
+	}
+#endif
+      
+      memset(dst,c,size);
+    }
+    
+    /// Splits the size bytes among the threads, passing each piece to f
+    ///
+    /// The pieces are processed serially if size is smaller than
+    /// parallelCopyThreshold, or if already inside a parallel
+    /// section. f receives the offset and size of the piece, and
+    /// whether stores must be non-temporal.
+    template <typename F>
+    void splitCopy(const int64_t& size,
+		   F&& f)
+    {
+      /// Use non-temporal stores if the destination exceeds the cache
+      const bool nonTemporal=
+	size>llcSize();
+      
+      if(size<ThreadPool::parallelCopyThreshold or
+	 ThreadPool::isInsideParallelSection())
+	f(0,size,nonTemporal);
+      else
+	ThreadPool::loopSplit((int64_t)0,(size+PARALLEL_COPY_PIECE_SIZE-1)/PARALLEL_COPY_PIECE_SIZE,
+			      [size,nonTemporal,&f](const int64_t& iPiece)
+			      {
+				/// Beginning of the piece
+				const int64_t beg=
+				  iPiece*PARALLEL_COPY_PIECE_SIZE;
+				
+				f(beg,std::min(PARALLEL_COPY_PIECE_SIZE,size-beg),nonTemporal);
+			      });
+    }
+  }
+  
+  /// Copies size bytes from src to dst
+  ///
+  /// The copy is split among the threads if larger than
+  /// parallelCopyThreshold, and not already inside a parallel section
+  inline void parallelMemcpy(void* dst,
+			     const void* src,
+			     const int64_t& size)
+  {
+    resources::splitCopy(size,
+			 [dst,src](const int64_t& beg,
+				   const int64_t& n,
+				   const bool& nonTemporal)
+			 {
+			   resources::memcpyPiece((char*)dst+beg,(const char*)src+beg,n,nonTemporal);
+			 });
+  }
+  
+  /// Sets size bytes of dst to c
+  ///
+  /// The filling is split among the threads as in parallelMemcpy
+  inline void parallelMemset(void* dst,
+			     const char& c,
+			     const int64_t& size)
+  {
+    resources::splitCopy(size,
+			 [dst,c](const int64_t& beg,
+				 const int64_t& n,
+				 const bool& nonTemporal)
+			 {
+			   resources::memsetPiece((char*)dst+beg,c,n,nonTemporal);
+			 });
+  }
+  
+  /// Copies src into dst, whose dimensions are stored in a different order
+  ///
+  /// The N dimensions have the passed sizes, and the passed strides
+  /// in the destination and in the source. The last dimension must
+  /// have unit stride in the destination.
+  ///
+  /// Adjacent dimensions which are contiguous both in the destination
+  /// and in the source are merged. If the innermost dimension of the
+  /// source is different from that of the destination, the two are
+  /// blocked in square tiles, so that both the source and the
+  /// destination are accessed along cache lines. The tiles are split
+  /// among the threads as in parallelMemcpy.
+  template <typename F,
+	    size_t N>
+  void parallelPermutedCopy(F* dst,
+			    const F* src,
+			    const std::array<int64_t,N>& sizes,
+			    const std::array<int64_t,N>& dstStrides,
+			    const std::array<int64_t,N>& srcStrides)
+  {
+    /// Number of dimensions after merging
+    int n=0;
+    
+    /// Sizes and strides of the merged dimensions
+    std::array<int64_t,N+1> mSizes,mDstStrides,mSrcStrides;
+    
+    /// Total number of elements
+    int64_t nElements=1;
+    
+    for(int d=0;d<(int)N;d++)
+      {
+	nElements*=sizes[d];
+	
+	// Dimensions of unit size do not contribute to the offsets
+	if(sizes[d]!=1)
+	  {
+	    if(n>0 and
+	       mDstStrides[n-1]==dstStrides[d]*sizes[d] and
+	       mSrcStrides[n-1]==srcStrides[d]*sizes[d])
+	      mSizes[n-1]*=sizes[d];
+	    else
+	      {
+		mSizes[n]=sizes[d];
+		n++;
+	      }
+	    
+	    mDstStrides[n-1]=dstStrides[d];
+	    mSrcStrides[n-1]=srcStrides[d];
+	  }
+      }
+    
+    if(nElements==0)
+      return;
+    
+    // A single element is left
+    if(n==0)
+      {
+	mSizes[0]=mDstStrides[0]=mSrcStrides[0]=1;
+	n=1;
+      }
+    
+    /// Innermost dimension in the destination
+    const int iIn=
+      n-1;
+    
+    /// Innermost dimension in the source
+    int kIn=
+      iIn;
+    
+    for(int k=0;k<n;k++)
+      if(mSrcStrides[k]==1)
+	kIn=k;
+    
+    /// Determine whether the two innermost dimensions are different, and must be blocked
+    const bool tiled=
+      (kIn!=iIn);
+    
+    /// Size of the tiles along the innermost dimension of the destination
+    const int64_t tileIn=
+      tiled?resources::PERMUTED_COPY_TILE_SIZE:mSizes[iIn];
+    
+    /// Size of the tiles along the innermost dimension of the source
+    const int64_t tileK=
+      tiled?resources::PERMUTED_COPY_TILE_SIZE:1;
+    
+    /// Number of tiles along the innermost dimension of the destination
+    const int64_t nTilesIn=
+      (mSizes[iIn]+tileIn-1)/tileIn;
+    
+    /// Number of tiles along the innermost dimension of the source
+    const int64_t nTilesK=
+      tiled?(mSizes[kIn]+tileK-1)/tileK:1;
+    
+    /// Determine whether the dimension is looped outside of the tiles
+    auto isOuter=
+      [tiled,kIn,iIn](const int& d)
+      {
+	return
+	  d!=iIn and (not tiled or d!=kIn);
+      };
+    
+    /// Number of elements spanned by the outer dimensions
+    int64_t nOuter=1;
+    
+    for(int d=0;d<n;d++)
+      if(isOuter(d))
+	nOuter*=mSizes[d];
+    
+    /// Copies a single tile
+    auto copyTile=
+      [=](int64_t iTile)
+      {
+	/// Tile along the innermost dimension of the destination
+	const int64_t tIn=
+	  iTile%nTilesIn;
+	iTile/=nTilesIn;
+	
+	/// Tile along the innermost dimension of the source
+	const int64_t tK=
+	  iTile%nTilesK;
+	iTile/=nTilesK;
+	
+	/// Offset of the tile in the destination and in the source
+	int64_t dstOffset=0,srcOffset=0;
+	
+	for(int d=n-1;d>=0;d--)
+	  if(isOuter(d))
+	    {
+	      /// Coordinate along the dimension
+	      const int64_t x=
+		iTile%mSizes[d];
+	      iTile/=mSizes[d];
+	      
+	      dstOffset+=x*mDstStrides[d];
+	      srcOffset+=x*mSrcStrides[d];
+	    }
+	
+	/// Range of the tile along the innermost dimension of the destination
+	const int64_t inBeg=
+	  tIn*tileIn;
+	
+	const int64_t inEnd=
+	  std::min(mSizes[iIn],inBeg+tileIn);
+	
+	if(tiled)
+	  {
+	    /// Range of the tile along the innermost dimension of the source
+	    const int64_t kBeg=
+	      tK*tileK;
+	    
+	    const int64_t kEnd=
+	      std::min(mSizes[kIn],kBeg+tileK);
+	    
+	    /// Stride of the tile rows in the destination
+	    const int64_t dstStrideK=
+	      mDstStrides[kIn];
+	    
+	    /// Stride of the tile columns in the source
+	    const int64_t srcStrideIn=
+	      mSrcStrides[iIn];
+	    
+	    for(int64_t k=kBeg;k<kEnd;k++)
+	      for(int64_t i=inBeg;i<inEnd;i++)
+		dst[dstOffset+k*dstStrideK+i]=
+		  src[srcOffset+k+i*srcStrideIn];
+	  }
+	else
+	  {
+	    /// Stride of the row in the source
+	    const int64_t srcStrideIn=
+	      mSrcStrides[iIn];
+	    
+	    for(int64_t i=inBeg;i<inEnd;i++)
+	      dst[dstOffset+i]=
+		src[srcOffset+i*srcStrideIn];
+	  }
+      };
+    
+    /// Number of tiles
+    const int64_t nTiles=
+      nOuter*nTilesK*nTilesIn;
+    
+    if(nElements*(int64_t)sizeof(F)<ThreadPool::parallelCopyThreshold or
+       ThreadPool::isInsideParallelSection())
+      for(int64_t iTile=0;iTile<nTiles;iTile++)
+	copyTile(iTile);
+    else
+      ThreadPool::loopSplit((int64_t)0,nTiles,
+			    [&copyTile](const int64_t& iTile)
+			    {
+			      copyTile(iTile);
+			    });
+  }
+}
+
+#endif
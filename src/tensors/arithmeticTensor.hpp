@@ -50,6 +50,38 @@ namespace maze
 	out;
     }
     
+    /// Sum another array
+    template <typename U,
+	      typename R=decltype(T()+U())>
+    CUDA_HOST_DEVICE
+    auto operator+(const ArithmeticArray<U,N>& oth) const
+    {
+      /// Result
+      ArithmeticArray<R,N> out;
+      
+      for(int i=0;i<N;i++)
+	out[i]=(*this)[i]+oth[i];
+      
+      return
+	out;
+    }
+    
+    /// Subtract another array
+    template <typename U,
+	      typename R=decltype(T()-U())>
+    CUDA_HOST_DEVICE
+    auto operator-(const ArithmeticArray<U,N>& oth) const
+    {
+      /// Result
+      ArithmeticArray<R,N> out;
+      
+      for(int i=0;i<N;i++)
+	out[i]=(*this)[i]-oth[i];
+      
+      return
+	out;
+    }
+    
     /// Summassign another array
     template <typename U>
     CUDA_HOST_DEVICE
@@ -74,7 +74,7 @@ namespace maze
     {
       return
 	SizeIsKnownAtCompileTime and
-	((Base::sizeAtCompileTime%simdLength<F>)==0);
+	(Base::sizeAtCompileTime==simdLength<F>);
     }
     
     /// Determine if this type can be simdified
@@ -11,6 +11,7 @@
 /// generalize to expr once we setup them
 
 #include <tensors/tensor.hpp>
+#include <threads/pool.hpp>
 
 namespace maze
 {
@@ -30,7 +31,7 @@ namespace maze
 				    I& i,  ///< Function to be executed
 				    SubsComps&&...subsComps) ///< Subscribed components
     {
-      f(i,std::forward_as_tuple(subsComps...));
+      f(i,TensorComps<std::decay_t<SubsComps>...>(subsComps...));
       i++;
     }
     
@@ -76,6 +77,63 @@ namespace maze
     
     impl::_loopOnAllComponentsValues((typename _T::Comps*)nullptr,std::forward<T>(t),std::forward<F>(f),i);
   }
+  
+  /// Loop on all components, splitting the most external one among the threads
+  ///
+  /// The function receives the same index and components it would
+  /// receive in the serial loop, but the order of the invocations is
+  /// not specified
+  template <typename T,
+	    typename F>
+  INLINE_FUNCTION
+  void parallelLoopOnAllComponentsValues(T&& t,F&& f)
+  {
+    /// BaseType
+    using _T=
+      typename std::decay_t<T>;
+    
+    /// Index
+    using Index=
+      typename _T::Index;
+    
+    /// Components to loop on
+    using Comps=
+      typename _T::Comps;
+    
+    if constexpr(std::tuple_size_v<Comps> ==0)
+      loopOnAllComponentsValues(std::forward<T>(t),std::forward<F>(f));
+    else
+      {
+	/// Component to be split among threads
+	using HeadComp=
+	  std::tuple_element_t<0,Comps>;
+	
+	/// Rest of the components, looped inside each thread
+	using ResidualComps=
+	  TupleAllButFirst<Comps>;
+	
+	/// Size of the split component
+	const Index headSize=
+	  t.template compSize<HeadComp>();
+	
+	/// Number of elements spanned by the residual components
+	Index residualSize=1;
+	forEachInTuple(ResidualComps{},[&t,&residualSize](const auto& c)
+				       {
+					 residualSize*=
+					   t.template compSize<std::decay_t<decltype(c)>>();
+				       });
+	
+	ThreadPool::loopSplit(Index(0),headSize,[&t,&f,residualSize](const Index& h)
+			      {
+				/// Index of the first element of the chunk
+				Index i=
+				  h*residualSize;
+				
+				impl::_loopOnAllComponentsValues((ResidualComps*)nullptr,t,f,i,HeadComp(h));
+			      });
+      }
+  }
 }
 
 
@@ -0,0 +1,166 @@
+#ifndef _MERGED_COMP_HPP
+#define _MERGED_COMP_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file mergedComp.hpp
+///
+/// \brief Component obtained merging a group of adjacent components
+///
+/// A group of components whose data is contiguous can be replaced by
+/// a single component, spanning the product of their sizes. Looping
+/// on the merged component runs on all the values of the group with
+/// a single loop, which the compiler can unroll and vectorize if the
+/// size is known at compile time.
+///
+/// \example
+///
+///  using T=Tensor<TensorComps<Site,Spin,Col,Compl>>;
+///  T t(Site(10));
+///  auto m=t.mergeCompontents<TensorComps<Spin,Col,Compl>>();
+///  // m has components (Site,MergedComp<Spin,Col,Compl>), the latter of size 24
+
+#include <type_traits>
+
+#include <tensors/component.hpp>
+#include <tensors/componentsList.hpp>
+#include <utilities/tuple.hpp>
+
+namespace maze
+{
+  namespace impl
+  {
+    /// Signature of a component merging the components C
+    ///
+    /// The size is the product of the sizes of the components, if
+    /// all of them are known at compile time
+    template <typename...C>
+    struct MergedCompSignature :
+      public TensorCompSize<std::common_type_t<int,typename C::Index...>,
+			    ((C::SizeIsKnownAtCompileTime and...)?
+			     (std::common_type_t<int,typename C::Index...>{1}*...*C::Base::sizeAtCompileTime):
+			     DYNAMIC)>
+    {
+      /// Type used for the index
+      using Index=
+	std::common_type_t<int,typename C::Index...>;
+      
+      /// Merged components
+      using Comps=
+	TensorComps<C...>;
+    };
+  }
+  
+  /// Component merging the components C, in the passed order
+  template <typename...C>
+  using MergedComp=
+    TensorComp<impl::MergedCompSignature<C...>,ANY,0>;
+  
+  namespace impl
+  {
+    /// Determine whether T is a merged component
+    template <typename T>
+    constexpr bool _isMergedComp=
+      false;
+    
+    /// Determine whether T is a merged component, positive case
+    template <typename...C>
+    constexpr bool _isMergedComp<MergedComp<C...>> =
+      true;
+    
+    /// Converts a group of components into the merged component
+    ///
+    /// Single components are left untouched
+    template <typename T>
+    struct _MergeGroup
+    {
+      /// Resulting type
+      using type=
+	T;
+    };
+    
+    /// Converts a group of components into the merged component
+    template <typename...C>
+    struct _MergeGroup<TensorComps<C...>>
+    {
+      /// Resulting type
+      using type=
+	MergedComp<C...>;
+    };
+    
+    /// Merges the groups of components of Tc
+    ///
+    /// Forward declaration
+    template <typename Tc>
+    struct _TensorCompsMerge;
+    
+    /// Merges the groups of components of Tc
+    template <typename...Tc>
+    struct _TensorCompsMerge<std::tuple<Tc...>>
+    {
+      /// Resulting type
+      using type=
+	TensorComps<typename _MergeGroup<Tc>::type...>;
+    };
+    
+    /// Determine whether the components G are adjacent in Tc, in the same order
+    template <typename...G,
+	      typename Tc>
+    constexpr bool _compsAreAdjacentIn(TensorComps<G...>*,
+				       Tc*)
+    {
+      if constexpr(sizeof...(G)==0)
+	return false;
+      else
+	{
+	  /// Position of the components
+	  constexpr int pos[]=
+	    {posOfType<G,Tc>...};
+	  
+	  for(int i=0;i<(int)sizeof...(G);i++)
+	    if(pos[i]==std::tuple_size_v<Tc> or pos[i]!=pos[0]+i)
+	      return false;
+	  
+	  return true;
+	}
+    }
+    
+    /// Determine whether the components G are adjacent in one of the lists Tc
+    template <typename G,
+	      typename...Tc>
+    constexpr bool _compsAreAdjacentInOneOf(std::tuple<Tc...>*)
+    {
+      return
+	(_compsAreAdjacentIn((G*)nullptr,(Tc*)nullptr) or...);
+    }
+  }
+  
+  /// Determine whether T is a merged component
+  template <typename T>
+  constexpr bool isMergedComp=
+    impl::_isMergedComp<T>;
+  
+  /// Replaces each group of components Groups found in Tc with the merged component
+  ///
+  /// \example
+  ///
+  ///  using A=TensorComps<Site,Spin,Col,Compl>;
+  ///  using B=TensorCompsMerge<A,TensorComps<Spin,Col>>; // TensorComps<Site,MergedComp<Spin,Col>,Compl>
+  template <typename Tc,
+	    typename...Groups>
+  using TensorCompsMerge=
+    typename impl::_TensorCompsMerge<TupleGroupTypes<Tc,Groups...>>::type;
+  
+  /// Determine whether the group G of components can be merged
+  ///
+  /// The group must not be empty, and the components must be
+  /// adjacent, in the same order, in one of the lists of MergeableComps
+  template <typename G,
+	    typename MergeableComps>
+  constexpr bool compsCanBeMerged=
+    impl::_compsAreAdjacentInOneOf<G>((MergeableComps*)nullptr);
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include "base/logger.hpp"
 #include "metaProgramming/nonConstMethod.hpp"
 #include "tensors/component.hpp"
+#include <array>
 #include <type_traits>
 #ifdef HAVE_CONFIG_H
 # include "config.hpp"
@@ -18,6 +19,7 @@
 #include <tensors/complex.hpp>
 #include <resources/storLoc.hpp>
 #include <tensors/componentsList.hpp>
+#include <tensors/mergedComp.hpp>
 #include <tensors/tensorFeat.hpp>
 #include <tensors/tensorSlice.hpp>
 #include <utilities/tuple.hpp>
@@ -26,13 +28,18 @@ namespace maze
 {
   /// Short name for the tensor
  #define THIS					\
-  Tensor<TensorComps<TC...>,F,SL,IsStackable>
+  Tensor<TensorComps<TC...>,F,SL,IsStackable,SO>
   
   /// Tensor
+  ///
+  /// The data is stored with the components in the order SO, the
+  /// last being the innermost. The components can be subscribed in
+  /// any order, independently from SO
   template <typename F,
 	    StorLoc SL,
 	    typename...TC,
-	    Stackable IsStackable>
+	    Stackable IsStackable,
+	    typename SO>
   struct THIS : public
     Expr<THIS,TensorComps<TC...>>,
     ComplexSubscribe<THIS>,
@@ -64,9 +71,33 @@ namespace maze
     using Comps=
       TensorComps<TC...>;
     
-    /// Mergeable components
+    /// Components in the order in which the data is stored
+    using StorageComps=
+      SO;
+    
+    static_assert(std::tuple_size_v<StorageComps> ==sizeof...(TC) and
+		  (TupleHasType<TC,StorageComps> and...),"Storage order must be a permutation of the components");
+    
+    /// The position in the loop on all components is the offset of the data
+    ///
+    /// The loop runs in the order of the components, so this holds
+    /// only if the data is stored in the same order
+    static constexpr bool loopIndexIsDataOffset=
+      std::is_same_v<StorageComps,Comps>;
+    
+    /// Determine whether the data is laid out as that of a tensor with components Cs
+    ///
+    /// In this case the i-th element of the data corresponds to the
+    /// i-th element of the other tensor
+    template <typename Cs>
+    static constexpr bool isLaidOutAs=
+      std::is_same_v<Cs,StorageComps>;
+    
+    /// Groups of components whose data is contiguous, which can be merged
+    ///
+    /// All the components of a tensor are contiguous, in the storage order
     using MergeableComps=
-      std::tuple<Comps>;
+      std::tuple<StorageComps>;
     
     /// Get the I-th component
     template <int I>
@@ -92,9 +123,9 @@ namespace maze
 	      ENABLE_THIS_TEMPLATE_IF(std::tuple_size<_Comps>::value>0)>
     static constexpr bool _canBeSimdified()
     {
-      /// Last component type
+      /// Innermost component
       using LastComp=
-	Comp<sizeof...(TC)-1>;
+	std::tuple_element_t<sizeof...(TC)-1,StorageComps>;
       
       return
 	LastComp::template canBeSimdified<Fund>;
@@ -113,6 +144,12 @@ namespace maze
     static constexpr bool canBeSimdified=
       _canBeSimdified<Fund,Comps>();
     
+    /// Component absorbed into simd, void if the tensor cannot be simdified
+    ///
+    /// This is the innermost component in the storage order
+    using SimdComp=
+      std::tuple_element_t<canBeSimdified?sizeof...(TC)-1:sizeof...(TC),TupleCat<StorageComps,std::tuple<void>>>;
+    
     /// Provide constant/not constant simdify method when not simdifiable
 #define PROVIDE_SIMDIFY(CONST_ATTR)					\
     /*! Convert into simdified, CONST_ATTR case */			\
@@ -133,7 +170,7 @@ namespace maze
     
     /// Provide constant/not constant simdify method when simdifiable
     ///
-    //// Last component is of the same size of simd_length
+    //// Innermost component is of the same size of simd_length
 #define PROVIDE_SIMDIFY(CONST_ATTR)					\
     /*! Convert into simdified, CONST_ATTR case */			\
     template <typename _F=F,						\
@@ -143,20 +180,14 @@ namespace maze
       CONST_ATTR							\
     {									\
       return								\
-	Tensor<TupleAllButLast<TensorComps<TC...>>,Simd<F>,SL,Stackable::CANNOT_GO_ON_STACK> \
-	((Simd<F>*)(this->getDataPtr()),this->data.getSize(),dynamicSizes); \
+	Tensor<TupleFilterOut<std::tuple<SimdComp>,Comps>,Simd<F>,SL,Stackable::CANNOT_GO_ON_STACK,TupleAllButLast<StorageComps>> \
+	((Simd<F>*)(this->getDataPtr()),this->data.getSize()/simdLength<F>,dynamicSizes); \
       }
     
     PROVIDE_SIMDIFY(const);
     PROVIDE_SIMDIFY(/* non const */);
     
 #undef PROVIDE_SIMDIFY
-
-    template <typename...MergedGroups>
-    auto mergeCompontents()
-    {
-#warning
-      }
     
 #if 0
     
@@ -201,9 +232,10 @@ namespace maze
     
     /// Static size
     static constexpr Index staticSize=
-      ((TC::SizeIsKnownAtCompileTime?
+      (Index{1}*...*
+       (TC::SizeIsKnownAtCompileTime?
 	TC::Base::sizeAtCompileTime:
-       Index{1})*...);
+	Index{1}));
     
     /// Size of the Tv component
     ///
@@ -231,61 +263,177 @@ namespace maze
 	std::get<Tv>(dynamicSizes);
     }
     
-    /// Calculate the index - no more components to parse
-    constexpr CUDA_HOST_DEVICE INLINE_FUNCTION
-    Index orderedCompsIndex(Index outer) ///< Value of all the outer components
+    /// Number of components
+    static constexpr int nComps=
+      sizeof...(TC);
+    
+    /// Position among the components of each component in the storage order
+    static constexpr std::array<int,nComps> posOfStorageComps=
+      std::apply([](const auto&...c)
+		 {
+		   return
+		     std::array<int,nComps>{posOfType<std::decay_t<decltype(c)>,Comps>...};
+		 },StorageComps{});
+    
+    /// Strides of the components, when known at compile time, zero otherwise
+    ///
+    /// The stride of a component is known if all the inner components
+    /// in the storage order have a size known at compile time
+    static constexpr std::array<Index,nComps> staticStrides=
+      []()
+      {
+	/// Sizes of the components, zero if dynamic, followed by a sentinel
+	constexpr Index sizes[]=
+	  {(TC::SizeIsKnownAtCompileTime?(Index)TC::Base::sizeAtCompileTime:Index{0})...,Index{1}};
+	
+	/// Result
+	std::array<Index,nComps> res{};
+	
+	/// Product of the sizes of the inner components
+	Index s=1;
+	for(int p=nComps-1;p>=0;p--)
+	  {
+	    /// Position of the component
+	    const int i=
+	      posOfStorageComps[p];
+	    
+	    res[i]=s;
+	    s*=sizes[i];
+	  }
+	
+	return res;
+      }();
+    
+    /// Strides of the components, computed at construction
+    ///
+    /// Empty if all components are static
+    using Strides=
+      std::array<Index,(std::tuple_size_v<DynamicComps> ==0)?0:nComps>;
+    
+    /// Strides of the components whose stride is not known at compile time
+    Strides strides;
+    
+    /// Computes the strides from the sizes of the components
+    CUDA_HOST_DEVICE
+    Strides computeStrides()
       const
     {
-      return
-	outer;
+      /// Result
+      Strides res{};
+      
+      if constexpr(std::tuple_size_v<Strides> >0)
+	{
+	  /// Sizes of the components
+	  const Index sizes[]=
+	    {(Index)compSize<TC>()...};
+	  
+	  /// Product of the sizes of the inner components
+	  Index s=1;
+	  for(int p=nComps-1;p>=0;p--)
+	    {
+	      /// Position of the component
+	      const int i=
+		posOfStorageComps[p];
+	      
+	      res[i]=s;
+	      s*=sizes[i];
+	    }
+	}
+      
+      return res;
     }
     
-    /// Calculate index iteratively
-    ///
-    /// Given the components (i,j,k) we must compute ((0*ni+i)*nj+j)*nk+k
+    /// Stride of the component C
     ///
-    /// The parsing of the variadic components is done left to right, so
-    /// to compute the nested bracket list we must proceed inward. Let's
-    /// say we are at component j. We define outer=(0*ni+i) the result
-    /// of inner step. We need to compute thisVal=outer*nj+j and pass it
-    /// to the inner step, which incorporate iteratively all the inner
-    /// components. The first step requires outer=0.
-    template <typename T,
-    	      typename...Tp>
+    /// Collapses to a constant if all the inner components are static
+    template <typename C>
     constexpr CUDA_HOST_DEVICE INLINE_FUNCTION
-    Index orderedCompsIndex(Index outer,        ///< Value of all the outer components
-			    T&& thisComp,       ///< Currently parsed component
-			    Tp&&...innerComps)  ///< Inner components
+    Index stride()
       const
     {
-      /// Remove reference and all attributes to access to types
-      using Tv=
-	std::decay_t<T>;
+      /// Position of the component
+      constexpr int i=
+	posOfType<C,Comps>;
       
-      /// Size of this component
-      const auto thisSize=
-	compSize<Tv>();
-      
-      //cout<<"thisSize: "<<thisSize<<endl;
-      /// Value of the index when including this component
-      const auto thisVal=
-	outer*thisSize+thisComp;
-      
-      return
-	orderedCompsIndex(thisVal,innerComps...);
+      if constexpr(staticStrides[i])
+	return staticStrides[i];
+      else
+	return strides[i];
     }
     
-    /// Intermediate layer to reorder the passed components
+    /// Computes the index of the passed components
+    ///
+    /// Each component is multiplied by its stride, so that the
+    /// products are independent from each other, and the components
+    /// are taken in the order of the tensor
     template <typename...T>
     constexpr CUDA_HOST_DEVICE INLINE_FUNCTION
     Index index(const TensorComps<T...>& comps)
       const
     {
-      /// Build the index reordering the components
       return
-	orderedCompsIndex(0,std::get<TC>(comps)...);
+	(Index{0}+...+((Index)std::get<TC>(comps)*stride<TC>()));
+    }
+    
+    /// Size of the component C, possibly merging other components
+    template <typename C>
+    CUDA_HOST_DEVICE INLINE_FUNCTION
+    Index mergedCompSize()
+      const
+    {
+      if constexpr(isMergedComp<C>)
+	return
+	  std::apply([this](const auto&...c)
+		     {
+		       return
+			 (Index{1}*...*(Index)compSize<std::decay_t<decltype(c)>>());
+		     },typename C::Base::Comps{});
+      else
+	return
+	  compSize<C>();
+    }
+    
+    /// Tensor obtained merging the groups of components MergedGroups
+    ///
+    /// The groups must be adjacent in the storage order
+    template <typename...MergedGroups>
+    using MergedTensor=
+      Tensor<TensorCompsMerge<Comps,MergedGroups...>,Fund,SL,Stackable::CANNOT_GO_ON_STACK,TensorCompsMerge<StorageComps,MergedGroups...>>;
+    
+    /// Provide constant/not constant method to merge components
+    ///
+    /// Each group of components is replaced by a single MergedComp,
+    /// spanning all their values. The groups must be adjacent in the
+    /// storage order. The returned tensor refers to the data of this one.
+#define PROVIDE_MERGE_COMPONENTS(CONST_ATTR)				\
+    /*! Merge the groups of components MergedGroups, CONST_ATTR case */ \
+    template <typename...MergedGroups>					\
+    auto mergeCompontents()						\
+      CONST_ATTR							\
+    {									\
+      static_assert((compsCanBeMerged<MergedGroups,MergeableComps> and...),"Merged components must be adjacent in the tensor"); \
+									\
+      /*! Resulting tensor */						\
+      using Res=							\
+	MergedTensor<MergedGroups...>;					\
+									\
+      /*! Sizes of the dynamic components of the result */		\
+      const auto resDynamicSizes=					\
+	std::apply([this](const auto&...c)				\
+		   {							\
+		     return						\
+		       typename Res::DynamicComps(mergedCompSize<std::decay_t<decltype(c)>>()...); \
+		   },typename Res::DynamicComps{});			\
+									\
+      return								\
+	Res((Fund*)(this->getDataPtr()),this->data.getSize(),resDynamicSizes); \
     }
     
+    PROVIDE_MERGE_COMPONENTS(const);
+    PROVIDE_MERGE_COMPONENTS(/* non const */);
+    
+#undef PROVIDE_MERGE_COMPONENTS
+    
     /// Determine whether the components are all static, or not
     static constexpr bool allCompsAreStatic=
       std::is_same<DynamicComps,std::tuple<>>::value;
@@ -310,7 +458,30 @@ namespace maze
 	data.getDataPtr();
     }
     
-    PROVIDE_ALSO_NON_CONST_METHOD_GPU(getDataPtr);
+    /// Returns the pointer to the data, to be possibly written
+    ///
+    /// The data is detached from the copies sharing it
+    CUDA_HOST_DEVICE
+    decltype(auto) getDataPtr()
+    {
+      detach();
+      
+      return
+	data.getDataPtr();
+    }
+    
+    /// Takes a private copy of the data, if shared with other copies
+    ///
+    /// Called before writing, so that the copies are not affected:
+    /// single elements are not detached when accessed. Nothing is
+    /// done if copy on write is disabled
+    CUDA_HOST_DEVICE INLINE_FUNCTION
+    void detach()
+    {
+#if defined USE_COPY_ON_WRITE and not defined COMPILING_FOR_DEVICE
+      data.detach();
+#endif
+    }
     
     // /// Returns the name of the type
     // static std::string nameOfType()
@@ -350,6 +521,7 @@ namespace maze
 	      ENABLE_THIS_TEMPLATE_IF(sizeof...(TD)>=1)>
     explicit Tensor(const TensorCompFeat<TD>&...tdFeat) :
       dynamicSizes{initializeDynSizes((DynamicComps*)nullptr,tdFeat.deFeat()...)},
+      strides(computeStrides()),
       data(staticSize*(tdFeat.deFeat()*...))
     {
     }
@@ -359,7 +531,8 @@ namespace maze
 	      ENABLE_THIS_TEMPLATE_IF(sizeof...(TD)==0)>
     CUDA_HOST_DEVICE
     Tensor() :
-      dynamicSizes{}
+      dynamicSizes{},
+      strides(computeStrides())
     {
     }
     
@@ -374,8 +547,8 @@ namespace maze
     
     /// Move constructor
     CUDA_HOST_DEVICE
-    Tensor(Tensor<TensorComps<TC...>,Fund,SL>&& oth) :
-      dynamicSizes(oth.dynamicSizes),data(std::move(oth.data))
+    Tensor(Tensor&& oth) :
+      dynamicSizes(oth.dynamicSizes),strides(oth.strides),data(std::move(oth.data))
     {
     }
     
@@ -384,21 +557,21 @@ namespace maze
     Tensor& operator=(Tensor&& oth)
     {
       std::swap(dynamicSizes,oth.dynamicSizes);
+      std::swap(strides,oth.strides);
       std::swap(data,oth.data);
       
       return *this;
     }
     
     /// Copy constructor
-    CUDA_HOST_DEVICE
+    ///
+    /// The data is copied in parallel, or shared until written if
+    /// copy on write is enabled. A copy of a reference owns its data
     Tensor(const Tensor& oth) :
       dynamicSizes(oth.dynamicSizes),
-      data(oth.data.getSize())
+      strides(oth.strides),
+      data(oth.data)
     {
-      #warning Mica labbiamo implementato
-      
-      // static_cast<Expr<Tensor>>(*this)=
-      // 	static_cast<const Expr<Tensor>&>(oth);
     }
     
     /// HACK
@@ -409,7 +582,7 @@ namespace maze
     Tensor(Fund* oth,
 	 const Size& size,
 	 const Dyn&...dynamicSizes) :
-      dynamicSizes(dynamicSizes...),data(oth,size)
+      dynamicSizes(dynamicSizes...),strides(computeStrides()),data(oth,size)
     {
     }
     
@@ -430,7 +603,15 @@ namespace maze
 	data[i];
     }
     
-    //PROVIDE_ALSO_NON_CONST_METHOD(trivialAccess);
+    /// Provide trivial access to the fundamental data, to be possibly written
+    ///
+    /// The data must have been detached in advance
+    INLINE_FUNCTION
+    Fund& trivialAccess(const Index& i)
+    {
+      return
+	data[i];
+    }
     
     /// Gets access to the inner data
     // const Fund* getRawAccess()
@@ -443,13 +624,49 @@ namespace maze
     // PROVIDE_ALSO_NON_CONST_METHOD(getRawAccess);
     
     /// Evaluate, returning a reference to the fundamental type
-    const Fund& eval(const TensorComps<TC...>& tc) const
+    ///
+    /// The passed components can be a superset of those of the
+    /// tensor, and can be listed in any order
+    template <typename...C>
+    const Fund& eval(const TensorComps<C...>& tc) const
+    {
+      return data[index(tc)];
+    }
+    
+    /// Evaluate, returning a reference to be possibly written
+    ///
+    /// The data must have been detached in advance, as done by the
+    /// subscribe operators and by the assignment
+    template <typename...C>
+    CUDA_HOST_DEVICE
+    Fund& eval(const TensorComps<C...>& tc)
     {
       return data[index(tc)];
     }
     
-    PROVIDE_ALSO_NON_CONST_METHOD_GPU(eval);
+    /// Provides the bind method, returning a slice of the tensor
+#define PROVIDE_BIND(CONST_ATTR,CONST_AS_BOOL)				\
+    /*! Bind the passed components, CONST_ATTR case */			\
+    /*!                                                            */	\
+    /*! The offset of the bound components is computed once for all */	\
+    template <typename...B>						\
+    CUDA_HOST_DEVICE INLINE_FUNCTION					\
+    auto bind(const TensorComps<B...>& b)				\
+      CONST_ATTR							\
+    {									\
+      /*! Slices write through const access, detach in advance */	\
+      if constexpr(not CONST_AS_BOOL)					\
+	this->detach();							\
+									\
+      return								\
+	TensorSlice<CONST_AS_BOOL,THIS,TensorComps<B...>>(*this,b);	\
+    }
     
+    PROVIDE_BIND(const,true);
+    PROVIDE_BIND(/* non const */,false);
+
+#undef PROVIDE_BIND
+
 #if 0
     /// We need to rethink this in the perspective of the partial evaluation
     
@@ -21,12 +21,29 @@ namespace maze
   
   /// Tensor with Comps components, of Fund fundamental type
   ///
+  /// The data is stored with the components in the order
+  /// StorageOrder, by default that of Comps
+  ///
   /// Forward definition to capture actual components
   template <typename Comps,
 	    typename Fund=double,
 	    StorLoc SL=DefaultStorage,
-	    Stackable IsStackable=Stackable::MIGHT_GO_ON_STACK>
+	    Stackable IsStackable=Stackable::MIGHT_GO_ON_STACK,
+	    typename StorageOrder=Comps>
   struct Tensor;
+  
+  /// Tensor with Comps components, stored in the order StorageOrder
+  ///
+  /// \example
+  ///
+  ///  // Struct of arrays: the site is the innermost component
+  ///  PermutedTensor<TensorComps<Site,Spin>,TensorComps<Spin,Site>> t(Site(10));
+  template <typename Comps,
+	    typename StorageOrder,
+	    typename Fund=double,
+	    StorLoc SL=DefaultStorage>
+  using PermutedTensor=
+    Tensor<Comps,Fund,SL,Stackable::MIGHT_GO_ON_STACK,StorageOrder>;
 }
 
 #endif
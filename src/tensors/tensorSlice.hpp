@@ -6,7 +6,8 @@
 /// \brief Implements a sliced view of a tensor
 
 #include <metaProgramming/feature.hpp>
-//#include <expr/expr.hpp>
+#include <expr/expr.hpp>
+#include <metaProgramming/constnessChanger.hpp>
 #include <tensors/complex.hpp>
 #include <tensors/component.hpp>
 #include <tensors/componentsList.hpp>
@@ -54,7 +55,7 @@ namespace maze
 	    typename ExtFund,
 	    bool CanBeCastToFund>
   struct THIS : public
-    // Expr<THIS>,
+    Expr<THIS,ExtComps>,
     ComplexSubscribe<THIS>,
   //AssignFromFundProvider<not IsConst,THIS,ExtFund>,
   //ToFundCastProvider<CanBeCastToFund,THIS,ConstIf<IsConst,ExtFund>,FundCastByRefVal::BY_REF>,
@@ -64,8 +65,14 @@ namespace maze
     static constexpr bool canBeCastToFund=
       CanBeCastToFund;
     
-    // /// Import assign operator from expression
-    // using Expr<THIS>::operator=;
+    /// Import assign operator from expression
+    using Expr<THIS,ExtComps>::operator=;
+    
+    /// Assign from another slice, element by element
+    TensorSlice& operator=(const TensorSlice& oth)
+    {
+      return this->_assign(oth);
+    }
     
     /// A slice can be copied easily
     static constexpr bool takeAsArgByRef=
@@ -79,6 +86,10 @@ namespace maze
     static constexpr bool canBeAssigned=
       not IsConst;
     
+    /// The position in the loop on all components is not the offset of the data
+    static constexpr bool loopIndexIsDataOffset=
+      false;
+    
     // /// Import assign operator from fund
     // template <typename O=ExtFund,
     // 	      bool CBA=canBeAssigned,
@@ -103,8 +114,16 @@ namespace maze
     using OrigTensor=
       T;
     
+    /// Components in the order in which the data of the original tensor is stored
+    using StorageComps=
+      TupleCommonTypes<Comps,typename T::StorageComps>;
+    
+    /// Type to be used for the index
+    using Index=
+      typename T::Index;
+    
     /// Reference to original tensor
-    const OrigTensor& t;
+    ConstIf<IsConst,OrigTensor>& t;
     
     /// Subscribed components
     using SubsComps=
@@ -113,6 +132,9 @@ namespace maze
     /// Subscribed components
     const SubsComps subsComps;
     
+    /// Offset of the first element of the slice, precomputed at binding
+    const Index offset;
+    
     /// Get components size from the tensor
     template <typename C>
     INLINE_FUNCTION constexpr
@@ -122,60 +144,81 @@ namespace maze
 	this->t.template compSize<C>();
     }
     
-    /// Provide subscribe operator when returning a reference
-#define PROVIDE_SUBSCRIBE_OPERATOR(CONST_ATTR,CONST_AS_BOOL)		\
-    /*! Operator to take a const slice to a given component */		\
-    template <typename C,						\
-	      typename Cp=Comps>					\
-    CUDA_HOST_DEVICE INLINE_FUNCTION					\
-    auto operator[](const TensorCompFeat<C>& cFeat) CONST_ATTR	\
-    {									\
-									\
-      /*! Nested reference subscribed components */			\
-      auto nestedSubsComps=						\
-	std::tuple_cat(subsComps,TensorComps<C>{cFeat.deFeat()});		\
-									\
-      /*! Type used to hold all components */				\
-      using NestedSubsComps=						\
-	decltype(nestedSubsComps);					\
-    									\
-      /*! Reference type */						\
-      using R=								\
-	TensorSlice<CONST_AS_BOOL or IsConst,T,NestedSubsComps>;		\
-      									\
-      return								\
-	R(this->t,nestedSubsComps);					\
+    /// Index of the passed residual components, relative to the offset
+    ///
+    /// The subscribed components are left to zero, so that their
+    /// contribution, already included in the offset, is not recomputed
+    template <typename...C>
+    CUDA_HOST_DEVICE INLINE_FUNCTION
+    Index residualIndex(const TensorComps<C...>& c)
+      const
+    {
+      return
+	t.index(fillTuple<typename T::Comps>(tupleGetSubset<Comps>(c)));
+    }
+    
+    /// Evaluate the slice on the residual components
+    ///
+    /// The passed components can be a superset of those of the slice
+    template <typename...C>
+    CUDA_HOST_DEVICE INLINE_FUNCTION
+    const Fund& eval(const TensorComps<C...>& c)
+      const
+    {
+      return
+	t.trivialAccess(offset+residualIndex(c));
+    }
+    
+    /// Evaluate the slice on the residual components, non const case
+    template <typename...C,
+	      bool IC=IsConst,
+	      ENABLE_THIS_TEMPLATE_IF(not IC)>
+    CUDA_HOST_DEVICE INLINE_FUNCTION
+    Fund& eval(const TensorComps<C...>& c)
+    {
+      return
+	asMutable(asConst(*this).eval(c));
     }
     
-    PROVIDE_SUBSCRIBE_OPERATOR(/* not const */, false);
-    PROVIDE_SUBSCRIBE_OPERATOR(const, true);
-    
-#undef PROVIDE_SUBSCRIBE_OPERATOR
-    
-    /// Provide eval method, converting to fundamental
-#define PROVIDE_EVAL_METHOD(CONST_ATTR)					\
-    /*! Operator to return direct access to data */			\
-    template <typename Cp=Comps,					\
-	      typename Ret=ConstIf<IsConst,Fund>&,			\
-	      ENABLE_THIS_TEMPLATE_IF(std::tuple_size<Cp>::value==0)>	\
-    CUDA_HOST_DEVICE INLINE_FUNCTION					\
-    Ret eval()								\
-      CONST_ATTR							\
-    {									\
-      return								\
-	(Ret)(t.trivialAccess(t.index(subsComps)));			\
+    /// Bind further components, returning a slice of the original tensor
+    template <typename...B>
+    CUDA_HOST_DEVICE INLINE_FUNCTION
+    auto bind(const TensorComps<B...>& b)
+      const
+    {
+      return
+	TensorSlice<IsConst,T,TensorComps<Sc...,B...>>(t,std::tuple_cat(subsComps,b));
     }
     
-    PROVIDE_EVAL_METHOD(/* not const */);
-    PROVIDE_EVAL_METHOD(const);
+    /// The data of a slice is not contiguous, so it is never laid out as a tensor
+    template <typename Cs>
+    static constexpr bool isLaidOutAs=
+      false;
+    
+    /// A slice cannot be simdified, since the simdified tensor would not outlive it
+    static constexpr bool canBeSimdified=
+      false;
     
-#undef PROVIDE_EVAL_METHOD
+    /// No component is absorbed into simd
+    using SimdComp=
+      void;
     
-    /// Create from slice and list of subscribed components
+    /// Create from tensor and list of subscribed components
     CUDA_HOST_DEVICE
-    TensorSlice(const TensorFeat<T>& t,
-	      const SubsComps& subsComps) :
-      t(t.deFeat()),subsComps(subsComps)
+    TensorSlice(ConstIf<IsConst,OrigTensor>& t,
+		const SubsComps& subsComps) :
+      t(t),
+      subsComps(subsComps),
+      offset(t.index(fillTuple<typename T::Comps>(subsComps)))
+    {
+    }
+    
+    /// Copy constructor, referring to the same data
+    CUDA_HOST_DEVICE
+    TensorSlice(const TensorSlice& oth) :
+      t(oth.t),
+      subsComps(oth.subsComps),
+      offset(oth.offset)
     {
     }
     
@@ -189,17 +232,13 @@ namespace maze
       
       static_assert(nDynComps==0,"Not supported if residual dynamic components are present");
       
-      /// Offset to data
-      const auto offset=
-	t.index(fillTuple<typename T::Comps>(subsComps));
-      
       /// Data with offset
       auto carriedData=
 	t.getDataPtr()+
 	offset;
       
       return
-	Tensor<Comps,typename T::Fund,T::storLoc,Stackable::CANNOT_GO_ON_STACK>(carriedData,t.data.getSize());
+	Tensor<Comps,typename T::Fund,T::storLoc,Stackable::CANNOT_GO_ON_STACK,StorageComps>(carriedData,t.data.getSize());
     }
   };
   
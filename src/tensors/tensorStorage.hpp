@@ -5,7 +5,10 @@
 # include "config.hpp"
 #endif
 
+#include <atomic>
+
 #include <resources/memoryManager.hpp>
+#include <resources/parallelCopy.hpp>
 #include <resources/storLoc.hpp>
 #include <tensors/componentSize.hpp>
 
@@ -34,6 +37,11 @@ namespace maze
   struct TensorStorage
   {
     /// Structure to hold dynamically allocated data
+    ///
+    /// Copies are deep, unless USE_COPY_ON_WRITE is defined: in that
+    /// case they share the data, counting the number of owners, until
+    /// detach is called before writing. Copies of the same storage
+    /// must not be taken concurrently.
     struct DynamicStorage
     {
       /// Hold info if it is a reference
@@ -44,6 +52,27 @@ namespace maze
       
       /// Allocated size
       Size dynSize;
+
+#ifdef USE_COPY_ON_WRITE
+      /// Number of owners sharing the data, nullptr if not shared
+      mutable std::atomic<int>* nOwners{nullptr};
+#endif
+      
+      /// Copy n elements of the data from src to dst
+      ///
+      /// The copy is done on the device if the data is stored there,
+      /// otherwise it is split among the threads
+      static void copyData(Fund* dst,
+			   const Fund* src,
+			   const Size& n)
+      {
+#ifdef USE_CUDA
+	if constexpr(SL==StorLoc::ON_GPU)
+	  DECRYPT_CUDA_ERROR(cudaMemcpy(dst,src,n*sizeof(Fund),cudaMemcpyDeviceToDevice),"Copying data on GPU");
+	else
+#endif
+	  parallelMemcpy(dst,src,n*sizeof(Fund));
+      }
       
       /// Returns the size
       constexpr Size getSize()
@@ -71,13 +100,31 @@ namespace maze
       {
       }
       
-      /// "Copy" constructor, actually taking a reference
-      CUDA_HOST_DEVICE
+      /// Copy constructor
+      ///
+      /// The data is copied in parallel, or shared if oth owns it
+      /// and copy on write is enabled
       DynamicStorage(const DynamicStorage& oth) :
-	isRef(true),
-	dynSize(oth.dynSize),
-	data(oth.data)
+	isRef(false),
+	data(nullptr),
+	dynSize(oth.dynSize)
       {
+#ifdef USE_COPY_ON_WRITE
+	if(not oth.isRef)
+	  {
+	    if(oth.nOwners==nullptr)
+	      oth.nOwners=new std::atomic<int>(1);
+	    
+	    oth.nOwners->fetch_add(1);
+	    nOwners=oth.nOwners;
+	    data=oth.data;
+	    
+	    return;
+	  }
+#endif
+	
+	data=memoryManager<SL>()->template provide<Fund>(dynSize);
+	copyData(data,oth.data,dynSize);
       }
       
       /// Create a reference starting from a pointer
@@ -100,6 +147,10 @@ namespace maze
 	oth.isRef=true;
 	oth.data=nullptr;
 	oth.dynSize=0;
+	
+#ifdef USE_COPY_ON_WRITE
+	std::swap(nOwners,oth.nOwners);
+#endif
       }
       
       /// Move assignment
@@ -109,14 +160,70 @@ namespace maze
 	std::swap(isRef,oth.isRef);
 	std::swap(data,oth.data);
 	std::swap(dynSize,oth.dynSize);
+#ifdef USE_COPY_ON_WRITE
+	std::swap(nOwners,oth.nOwners);
+#endif
 	
 	return *this;
       }
       
+#ifdef USE_COPY_ON_WRITE
+      /// Determine whether the data is shared with other copies
+      INLINE_FUNCTION
+      bool isShared() const
+      {
+	return
+	  nOwners!=nullptr;
+      }
+      
+      /// Give up the ownership of the shared data
+      ///
+      /// Returns true if this was the last owner
+      bool leaveSharing()
+      {
+	/// Determine if the last owner
+	const bool isLast=
+	  nOwners->fetch_sub(1)==1;
+	
+	if(isLast)
+	  delete nOwners;
+	
+	nOwners=nullptr;
+	
+	return isLast;
+      }
+      
+      /// Takes a private copy of the data, if shared
+      void detach()
+      {
+	if(not isShared())
+	  return;
+	
+	/// Data shared with the other owners
+	Fund* sharedData=
+	  data;
+	
+	// If some other owner is left, copy the data
+	if(nOwners->load()>1)
+	  {
+	    data=memoryManager<SL>()->template provide<Fund>(dynSize);
+	    copyData(data,sharedData,dynSize);
+	  }
+	
+	if(leaveSharing() and data!=sharedData)
+	  memoryManager<SL>()->release(sharedData);
+      }
+#endif
+      
       #ifndef COMPILING_FOR_DEVICE
       /// Destructor deallocating the memory
       ~DynamicStorage()
       {
+#ifdef USE_COPY_ON_WRITE
+	if(isShared() and not leaveSharing())
+	  return;
+#endif
+	
 	if(not isRef)
 	  memoryManager<SL>()->release(data);
       }
@@ -134,8 +241,8 @@ namespace maze
 	  StaticSize;
       }
       
-      /// Storage
-      Fund data[StaticSize];
+      /// Storage, aligned so that it can be accessed as simd vectors
+      alignas(DEFAULT_ALIGNMENT) Fund data[StaticSize];
       
       /// Return the pointer to inner data
       INLINE_FUNCTION CUDA_HOST_DEVICE
@@ -158,7 +265,7 @@ namespace maze
       CUDA_HOST_DEVICE
       explicit StackStorage(const StackStorage& oth)
       {
-	memcpy(this->data,oth.data,StaticSize);
+	memcpy(this->data,oth.data,StaticSize*sizeof(Fund));
       }
       
       // /// Move constructor is deleted
@@ -203,6 +310,17 @@ namespace maze
 	data.getSize();
     }
     
+    /// Takes a private copy of the data, if shared with other copies
+    INLINE_FUNCTION
+    void detach()
+    {
+#ifdef USE_COPY_ON_WRITE
+      if constexpr(not stackAllocated)
+	if(data.isShared())
+	  data.detach();
+#endif
+    }
+    
     /// Construct taking the size to allocate
     TensorStorage(const Size& size) ///< Size to allocate
       : data(size)
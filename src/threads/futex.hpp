@@ -0,0 +1,37 @@
+#ifndef _FUTEX_HPP
+#define _FUTEX_HPP
+
+/// \file futex.hpp
+///
+/// \brief Wraps the futex system call, to put threads to sleep
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+#include <atomic>
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace maze
+{
+  /// Put the calling thread to sleep as long as the value is the expected one
+  ///
+  /// Spurious wake up are possible, so the caller must check again
+  /// the value after returning
+  inline void futexWait(std::atomic<int>& val,   ///< Value to be watched
+			const int& expected)     ///< Value for which the thread sleeps
+  {
+    syscall(SYS_futex,reinterpret_cast<int*>(&val),FUTEX_WAIT_PRIVATE,expected,nullptr,nullptr,0);
+  }
+  
+  /// Wake up all threads sleeping on the value
+  inline void futexWakeAll(std::atomic<int>& val) ///< Value watched by sleeping threads
+  {
+    syscall(SYS_futex,reinterpret_cast<int*>(&val),FUTEX_WAKE_PRIVATE,INT_MAX,nullptr,nullptr,0);
+  }
+}
+
+#endif
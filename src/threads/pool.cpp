@@ -31,7 +31,7 @@ namespace maze
 	{
 	  resources::waitForWork();
 	  
-	  work(threadId);
+	  resources::executeWork(threadId);
 	}
       while(poolIsStarted);
       
@@ -57,6 +57,8 @@ namespace maze
 	  
 	  // Remove all pthreads
 	  resources::pool.resize(0);
+	  
+	  work.reset();
 	}
 #endif
     }
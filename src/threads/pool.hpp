@@ -10,12 +10,16 @@
 #endif
 
 #include <atomic>
-#include <functional>
+#include <cstdint>
+#include <new>
 #include <omp.h>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <debug/crasher.hpp>
+#include <threads/futex.hpp>
 #include <unroll/inliner.hpp>
 
 #ifndef EXTERN_POOL
@@ -27,6 +31,30 @@
 
 namespace maze
 {
+  namespace ThreadPool
+  {
+    /// Minimal number of elements for which an assignment is split among the threads
+    EXTERN_POOL int64_t parallelAssignThreshold INIT_POOL_TO(32768);
+    
+    /// Minimal number of bytes for which a copy is split among the threads
+    EXTERN_POOL int64_t parallelCopyThreshold INIT_POOL_TO(1<<18);
+    
+    /// Possible ways to schedule the iterations of a split loop
+    enum LoopSchedule{STATIC,  ///< Each thread executes an equal contiguous chunk
+		      DYNAMIC, ///< Threads take chunks of loopChunkSize, stealing when done
+		      GUIDED   ///< As dynamic, with chunks decreasing from half the remaining ones
+    };
+    
+    /// Schedule used by default in split loops, one of LoopSchedule
+    EXTERN_POOL int loopSchedule INIT_POOL_TO(STATIC);
+    
+    /// Size of the chunk (minimal, in the guided case) of the dynamic schedules
+    EXTERN_POOL int64_t loopChunkSize INIT_POOL_TO(16);
+    
+    /// Number of iterations a thread spins waiting for work, before going to sleep
+    EXTERN_POOL int64_t poolSpinIterations INIT_POOL_TO(1<<16);
+  }
+  
 #ifdef USE_THREADS
   
   /// Starts the pool as detached or not
@@ -73,10 +101,13 @@ namespace maze
     {
       /// Incapsulate the threads
       EXTERN_POOL std::vector<pthread_t> pool;
+      
+      /// Store whether the current thread is executing a work of the pool
+      EXTERN_POOL thread_local bool insideParallelSection INIT_POOL_TO(false);
     }
     
-    /// Maximal size of the stack used for thw work
-    //static constexpr int MAX_POOL_FUNCTION_SIZE=128;
+    /// Maximal size of the closure of the work, stored inside the pool
+    static constexpr int MAX_POOL_FUNCTION_SIZE=128;
     
     /// Number of threads waiting for work
     EXTERN_POOL std::atomic<int> nThreadsWaitingForWork INIT_POOL_TO(0);
@@ -84,13 +115,86 @@ namespace maze
     /// Count the number of assigned works
     EXTERN_POOL std::atomic<int> nWorksAssigned INIT_POOL_TO(0);
     
+    /// Number of threads sleeping waiting for work
+    EXTERN_POOL std::atomic<int> nThreadsSleeping INIT_POOL_TO(0);
+    
     /// States if the pool is started
     EXTERN_POOL bool poolIsStarted INIT_POOL_TO(false);
     
     /// Type to encapsulate the work to be done
-    using Work=
-      std::function<void(int)>;
-    //stdext::inplace_function<void(int),MAX_POOL_FUNCTION_SIZE>;
+    ///
+    /// The closure is copied in a buffer of fixed capacity owned by
+    /// the pool, and invoked through a trampoline aware of its type,
+    /// so that no allocation is needed to dispatch a work
+    struct Work
+    {
+      /// Alignment of the storage
+      static constexpr std::size_t storageAlignment=
+	64;
+      
+      /// Storage of the closure
+      alignas(storageAlignment) unsigned char storage[MAX_POOL_FUNCTION_SIZE];
+      
+      /// Invoke the stored closure
+      void(*trampoline)(void*,int)
+	{nullptr};
+      
+      /// Destroy the stored closure
+      void(*destroyer)(void*)
+	{nullptr};
+      
+      /// Store the closure, destroying the previous one
+      template <typename F>
+      INLINE_FUNCTION
+      void set(F&& f)
+      {
+	/// Type of the closure
+	using T=
+	  std::decay_t<F>;
+	
+	static_assert(sizeof(T)<=MAX_POOL_FUNCTION_SIZE,"Closure too large to be stored in the pool, capture by reference");
+	static_assert(alignof(T)<=storageAlignment,"Closure too aligned to be stored in the pool");
+	
+	reset();
+	
+	new(storage) T(std::forward<F>(f));
+	
+	trampoline=
+	  [](void* closure,int threadId)
+	  {
+	    (*static_cast<T*>(closure))(threadId);
+	  };
+	
+	destroyer=
+	  [](void* closure)
+	  {
+	    static_cast<T*>(closure)->~T();
+	  };
+      }
+      
+      /// Invoke the work
+      INLINE_FUNCTION
+      void operator()(const int& threadId)
+      {
+	trampoline(storage,threadId);
+      }
+      
+      /// Destroy the stored closure, if any
+      void reset()
+      {
+	if(destroyer)
+	  destroyer(storage);
+	
+	trampoline=nullptr;
+	destroyer=nullptr;
+      }
+      
+      /// Destroy the stored closure
+      ~Work()
+      {
+	reset();
+      }
+    };
     
     /// Work to be done in the pool
     ///
@@ -134,14 +238,49 @@ namespace maze
       while(poolIsStarted and nThreadsWaitingForWork!=nThreads-1);
     }
     
+    /// Returns whether the calling thread is executing a work of the pool
+    ///
+    /// A new parallel section cannot be opened from inside another one
+    INLINE_FUNCTION
+    bool isInsideParallelSection()
+    {
+      return resources::insideParallelSection;
+    }
+    
+    namespace resources
+    {
+      /// Execute the work, keeping track that we are inside a parallel section
+      INLINE_FUNCTION
+      void executeWork(const int& threadId)
+      {
+	insideParallelSection=true;
+	
+	work(threadId);
+	
+	insideParallelSection=false;
+      }
+    }
+    
     namespace resources
     {
       /// Wait that the count of the number of work has been increased
+      ///
+      /// Spins for poolSpinIterations, then sleeps until woken up by the master
       INLINE_FUNCTION
       void waitThatMasterSignalsNewWork(const int& prevNWorkAssigned)
       {
 	// The work will be assigned only when the master sees all workers waiting
-	while(nWorksAssigned.load(std::memory_order_relaxed)==prevNWorkAssigned);
+	for(int64_t iSpin=0;nWorksAssigned.load(std::memory_order_relaxed)==prevNWorkAssigned;iSpin++)
+	  if(iSpin>=poolSpinIterations)
+	    {
+	      // The counter must be increased before checking the value,
+	      // so that the master cannot miss the sleeping thread
+	      nThreadsSleeping.fetch_add(1);
+	      
+	      futexWait(nWorksAssigned,prevNWorkAssigned);
+	      
+	      nThreadsSleeping.fetch_sub(1);
+	    }
       }
       
       /// Wait for the work to come
@@ -219,44 +358,222 @@ namespace maze
       else
 	{
 	  waitThatAllWorkersWaitForWork();
-	  work=std::move(f);
+	  work.set(std::forward<F>(f));
 	  
 	  nThreadsWaitingForWork=0;
-	  nWorksAssigned.store(nWorksAssigned+1,std::memory_order_release);
+	  nWorksAssigned.fetch_add(1);
+	  
+	  // Wake up the threads which went to sleep
+	  if(nThreadsSleeping.load()>0)
+	    futexWakeAll(nWorksAssigned);
+	  
+	  resources::executeWork(masterThreadId);
+	  
+	  // Wait that all workers have completed their part, so that
+	  // the result can be used as soon as we return
+	  waitThatAllWorkersWaitForWork();
+	  
+	  // When the pool is being stopped the workers are not waited
+	  // for, so the work is destroyed only after joining them
+	  if(poolIsStarted)
+	    work.reset();
+	}
+    }
+    
+    /// Range [beg,end) assigned to a thread when splitting a loop in \c nPieces chunks
+    ///
+    /// All the code which must match the partition of loopSplit
+    /// (e.g. the first touch of memory) must use this
+    template <typename Size>           // Type for the range of the loop
+    INLINE_FUNCTION
+    std::pair<Size,Size> chunkOfThread(const Size& beg,       ///< Beginning of the loop
+				       const Size& end,       ///< End of the loop
+				       const int& nPieces,    ///< Number of chunks
+				       const int& threadId)   ///< Thread asking for its chunk
+    {
+      /// Workload for each thread, taking into account the remainder
+      const Size threadLoad
+	{(end-beg+nPieces-1)/nPieces};
+      
+      /// Beginning of the chunk
+      const Size threadBeg
+	{std::min(end,beg+threadLoad*threadId)};
+      
+      /// End of the assignment for last bunch, if \c end is not smaller
+      const Size lastBunchEnd
+	{threadBeg+threadLoad};
+      
+      /// End of the chunk
+      const Size threadEnd
+	{std::min(end,lastBunchEnd)};
+      
+      return
+	{threadBeg,threadEnd};
+    }
+    
+    namespace resources
+    {
+      /// Range of iterations still to be executed by a thread
+      ///
+      /// Begin and end, relative to the beginning of the loop, are
+      /// packed in a single word, so that the owner and the thieves
+      /// can update them atomically
+      struct alignas(64) PackedRange
+      {
+	/// Begin in the lower half, end in the upper one
+	std::atomic<uint64_t> packed;
+	
+	/// Pack begin and end
+	static uint64_t pack(const uint32_t& beg,
+			     const uint32_t& end)
+	{
+	  return
+	    ((uint64_t)end<<32)|beg;
+	}
+	
+	/// Take from the beginning a chunk, returning false if empty
+	///
+	/// To be called by the owner of the range
+	INLINE_FUNCTION
+	bool takeChunk(uint32_t& beg,
+		       uint32_t& end,
+		       const int& schedule,
+		       const uint32_t& chunkSize)
+	{
+	  /// Current range
+	  uint64_t cur=
+	    packed.load(std::memory_order_relaxed);
+	  
+	  do
+	    {
+	      beg=(uint32_t)cur;
+	      end=(uint32_t)(cur>>32);
+	      
+	      if(beg>=end)
+		return false;
+	      
+	      /// Number of iterations left
+	      const uint32_t nLeft=
+		end-beg;
+	      
+	      /// Iterations to be taken
+	      const uint32_t nTaken=
+		std::min(nLeft,(schedule==GUIDED)?std::max(chunkSize,nLeft/2):chunkSize);
+	      
+	      end=beg+nTaken;
+	    }
+	  while(not packed.compare_exchange_weak(cur,pack(end,(uint32_t)(cur>>32))));
+	  
+	  return true;
+	}
+	
+	/// Steal the second half of the range, returning false if empty
+	///
+	/// To be called by threads different from the owner
+	INLINE_FUNCTION
+	bool steal(uint32_t& beg,
+		   uint32_t& end)
+	{
+	  /// Current range
+	  uint64_t cur=
+	    packed.load(std::memory_order_relaxed);
 	  
-	  work(masterThreadId);
+	  do
+	    {
+	      /// Begin of the victim range
+	      const uint32_t victimBeg=
+		(uint32_t)cur;
+	      
+	      end=(uint32_t)(cur>>32);
+	      
+	      if(victimBeg>=end)
+		return false;
+	      
+	      beg=victimBeg+(end-victimBeg)/2;
+	    }
+	  while(not packed.compare_exchange_weak(cur,pack((uint32_t)cur,beg)));
+	  
+	  return true;
 	}
+      };
+      
+      /// Ranges of iterations of each thread, used by the dynamic schedules
+      EXTERN_POOL std::vector<PackedRange> ranges INIT_POOL_TO(nThreads);
     }
     
     /// Split a loop into \c nTrheads chunks, giving each chunk as a work for a corresponding thread
+    ///
+    /// With the dynamic schedules, each thread starts from the chunk
+    /// of the static one, executing it loopChunkSize iterations (or
+    /// a guided amount) at a time. When done, it steals half of the
+    /// iterations left to the other threads, until none is left.
     template <typename Size,           // Type for the range of the loop
 	      typename F>              // Type of the function
     INLINE_FUNCTION
     void loopSplit(const Size& beg,  ///< Beginning of the loop
 		   const Size& end,  ///< End of the loop
-		   F&& f)            ///< Function to be called
+		   F&& f,            ///< Function to be called
+		   const int& schedule=loopSchedule) ///< Schedule to be used
     {
-      parallel([beg,end,nPieces=nThreads,f](const int& threadId) mutable
-	       {
-		 /// Workload for each thread, taking into account the remainder
-		 const Size threadLoad
-		   {(end-beg+nPieces-1)/nPieces};
-		 
-		 /// Beginning of the chunk
-		 const Size threadBeg
-		   {threadLoad*threadId};
-		 
-		 /// End of the assignment for last bunch, if \c end is not smaller
-		 const Size lastBunchEnd
-		   {threadBeg+threadLoad};
-		 
-		 /// End of the chunk
-		 const Size threadEnd
-		   {std::min(end,lastBunchEnd)};
-		 
-		 for(Size i=threadBeg;i<threadEnd;i++)
-		   f(i);
-	       });
+      /// Number of iterations
+      const Size n=
+	std::max(end-beg,(Size)0);
+      
+      // Ranges are packed in 32 bits
+      if(schedule==STATIC or (uint64_t)n>=((uint64_t)1<<32))
+	parallel([beg,end,nPieces=nThreads,f](const int& threadId) mutable
+		 {
+		   /// Chunk of this thread
+		   const auto [threadBeg,threadEnd]=
+		     chunkOfThread(beg,end,nPieces,threadId);
+		   
+		   for(Size i=threadBeg;i<threadEnd;i++)
+		     f(i);
+		 });
+      else
+	{
+	  for(int threadId=0;threadId<nThreads;threadId++)
+	    {
+	      /// Initial chunk of the thread
+	      const auto [threadBeg,threadEnd]=
+		chunkOfThread((Size)0,n,nThreads,threadId);
+	      
+	      resources::ranges[threadId].packed=
+		resources::PackedRange::pack(threadBeg,threadEnd);
+	    }
+	  
+	  parallel([beg,schedule,chunkSize=(uint32_t)std::max(loopChunkSize,(int64_t)1),f](const int& threadId) mutable
+		   {
+		     /// Range of this thread
+		     resources::PackedRange& ownRange=
+		       resources::ranges[threadId];
+		     
+		     /// Chunk to be executed
+		     uint32_t chunkBeg,chunkEnd;
+		     
+		     /// Execute all chunks of the own range
+		     auto executeOwnRange=
+		       [&]()
+		       {
+			 while(ownRange.takeChunk(chunkBeg,chunkEnd,schedule,chunkSize))
+			   for(uint32_t i=chunkBeg;i<chunkEnd;i++)
+			     f(beg+(Size)i);
+		       };
+		     
+		     executeOwnRange();
+		     
+		     // Steal from other threads, starting from the next one
+		     for(int iVictim=1;iVictim<nThreads;iVictim++)
+		       while(resources::ranges[(threadId+iVictim)%nThreads].steal(chunkBeg,chunkEnd))
+			 {
+			   // Move the stolen iterations to the own range, so they can be stolen further
+			   ownRange.packed=
+			     resources::PackedRange::pack(chunkBeg,chunkEnd);
+			   
+			   executeOwnRange();
+			 }
+		   });
+	}
     }
   }
   
@@ -269,6 +586,12 @@ namespace maze
     {
     }
     
+    INLINE_FUNCTION
+    bool isInsideParallelSection()
+    {
+      return false;
+    }
+    
     INLINE_FUNCTION
     void waitForWork()
     {
@@ -279,7 +602,8 @@ namespace maze
     INLINE_FUNCTION
     void loopSplit(const Size& beg,  ///< Beginning of the loop
 		   const Size& end,  ///< End of the loop
-		   F&& f)            ///< Function to be called
+		   F&& f,            ///< Function to be called
+		   const int& /*schedule*/=loopSchedule) ///< Schedule, irrelevant
     {
       for(Size i=beg;i<end;i++)
 	f(i);
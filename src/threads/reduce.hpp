@@ -0,0 +1,189 @@
+#ifndef _REDUCE_HPP
+#define _REDUCE_HPP
+
+/// \file reduce.hpp
+///
+/// \brief Reductions over loops split among the threads
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include <base/ranks.hpp>
+#include <threads/pool.hpp>
+#include <unroll/inliner.hpp>
+
+namespace maze
+{
+  namespace ThreadPool
+  {
+    namespace resources
+    {
+      /// Partial result of a reduction, occupying whole cache lines
+      ///
+      /// Avoids that threads accumulating their partial results
+      /// write on the same cache line
+      template <typename T>
+      struct alignas(64) ReductionPartial
+      {
+	/// Partial result
+	T val;
+      };
+      
+      /// Storage for the partial results of the reductions of type T
+      ///
+      /// Kept across calls so that no allocation takes place after
+      /// the first reduction. Only the master thread accesses it.
+      template <typename T>
+      std::vector<ReductionPartial<T>>& reductionPartials()
+      {
+	/// Partials, one per thread
+	static std::vector<ReductionPartial<T>> partials;
+	
+	return
+	  partials;
+      }
+    }
+    
+    /// Reduce the result of f(i) for i in [beg,end) through op
+    ///
+    /// \a init must be the identity of \a op, as it is used to start
+    /// the accumulation of each thread. The iterations are split
+    /// statically as in loopSplit, each thread accumulates its
+    /// chunk in order, and the partials are combined in order of
+    /// thread, so that the result is reproducible for a given
+    /// number of threads, also in floating point.
+    template <typename Size,           // Type for the range of the loop
+	      typename T,              // Type of the result
+	      typename F,              // Type of the function
+	      typename Op>             // Type of the reduction operation
+    T loopReduce(const Size& beg,  ///< Beginning of the loop
+		 const Size& end,  ///< End of the loop
+		 const T& init,    ///< Identity of the operation
+		 F&& f,            ///< Function returning the contribution of i
+		 Op&& op)          ///< Operation combining two values
+    {
+#ifdef USE_THREADS
+      /// Partials of all threads
+      std::vector<resources::ReductionPartial<T>>& partials=
+	resources::reductionPartials<T>();
+      
+      if((int)partials.size()<nThreads)
+	partials.resize(nThreads);
+      
+      parallel([&](const int& threadId)
+	       {
+		 /// Chunk of this thread
+		 const auto [threadBeg,threadEnd]=
+		   chunkOfThread(beg,end,nThreads,threadId);
+		 
+		 /// Accumulate locally, writing the partial only at the end
+		 T partial=
+		   init;
+		 
+		 for(Size i=threadBeg;i<threadEnd;i++)
+		   partial=
+		     op(partial,f(i));
+		 
+		 partials[threadId].val=
+		   partial;
+	       });
+      
+      /// Result
+      T res=
+	init;
+      
+      for(int threadId=0;threadId<nThreads;threadId++)
+	res=
+	  op(res,partials[threadId].val);
+      
+      return
+	res;
+#else
+      /// Result
+      T res=
+	init;
+      
+      for(Size i=beg;i<end;i++)
+	res=
+	  op(res,f(i));
+      
+      return
+	res;
+#endif
+    }
+    
+    /// Sums f(i) for i in [beg,end)
+    ///
+    /// If \a amongRanks is asked, the sum is also taken among all ranks
+    template <typename Size,           // Type for the range of the loop
+	      typename F>              // Type of the function
+    auto loopSum(const Size& beg,            ///< Beginning of the loop
+		 const Size& end,            ///< End of the loop
+		 F&& f,                      ///< Function returning the addend i
+		 const bool& amongRanks=false) ///< Sum also among ranks
+    {
+      /// Type of the result
+      using T=
+	std::decay_t<decltype(f(beg))>;
+      
+      /// Local result
+      const T res=
+	loopReduce(beg,end,T{},std::forward<F>(f),[](const T& x,const T& y){return x+y;});
+      
+      if(amongRanks)
+	return
+	  ranksAllReduceSum(res);
+      else
+	return
+	  res;
+    }
+    
+    /// Maximum of f(i) for i in [beg,end)
+    ///
+    /// If \a amongRanks is asked, the maximum is also taken among all ranks
+    template <typename Size,           // Type for the range of the loop
+	      typename F>              // Type of the function
+    auto loopMax(const Size& beg,            ///< Beginning of the loop
+		 const Size& end,            ///< End of the loop
+		 F&& f,                      ///< Function returning the element i
+		 const bool& amongRanks=false) ///< Maximum also among ranks
+    {
+      /// Type of the result
+      using T=
+	std::decay_t<decltype(f(beg))>;
+      
+      /// Local result
+      const T res=
+	loopReduce(beg,end,std::numeric_limits<T>::lowest(),std::forward<F>(f),[](const T& x,const T& y){return std::max(x,y);});
+      
+      if(amongRanks)
+	return
+	  ranksAllReduceMax(res);
+      else
+	return
+	  res;
+    }
+    
+    /// Scalar product of the sequences a and b, indexed in [beg,end)
+    template <typename Size,           // Type for the range of the loop
+	      typename A,              // Type of the first sequence
+	      typename B>              // Type of the second sequence
+    auto loopDot(const Size& beg,            ///< Beginning of the loop
+		 const Size& end,            ///< End of the loop
+		 const A& a,                 ///< First sequence
+		 const B& b,                 ///< Second sequence
+		 const bool& amongRanks=false) ///< Sum also among ranks
+    {
+      return
+	loopSum(beg,end,[&a,&b](const Size& i){return a[i]*b[i];},amongRanks);
+    }
+  }
+}
+
+#endif
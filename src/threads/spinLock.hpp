@@ -0,0 +1,45 @@
+#ifndef _SPIN_LOCK_HPP
+#define _SPIN_LOCK_HPP
+
+/// \file spinLock.hpp
+///
+/// \brief Implements a minimal spin lock
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+#include <atomic>
+
+#include <unroll/inliner.hpp>
+
+namespace maze
+{
+  /// Lock busy-waiting to be acquired
+  ///
+  /// To be used to protect very short critical sections, such as
+  /// pushing or popping from a list. Satisfies the BasicLockable
+  /// requirement, so it can be used with std::lock_guard
+  struct SpinLock
+  {
+    /// Flag marking the lock as taken
+    std::atomic_flag flag=
+      ATOMIC_FLAG_INIT;
+    
+    /// Acquire the lock
+    INLINE_FUNCTION
+    void lock()
+    {
+      while(flag.test_and_set(std::memory_order_acquire));
+    }
+    
+    /// Release the lock
+    INLINE_FUNCTION
+    void unlock()
+    {
+      flag.clear(std::memory_order_release);
+    }
+  };
+}
+
+#endif
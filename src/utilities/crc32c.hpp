@@ -0,0 +1,95 @@
+#ifndef _CRC32C_HPP
+#define _CRC32C_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.hpp"
+#endif
+
+/// \file crc32c.hpp
+///
+/// \brief CRC-32C (Castagnoli) checksum
+///
+/// Uses the crc32 instruction when SSE 4.2 is available, a lookup
+/// table otherwise. Both give the same result.
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE4_2__
+# include <nmmintrin.h>
+#endif
+
+namespace maze
+{
+  namespace resources
+  {
+    /// Reversed Castagnoli polynomial
+    constexpr uint32_t CRC32C_POLY=
+      0x82F63B78;
+    
+    /// Table to compute the CRC byte by byte
+    constexpr std::array<uint32_t,256> crc32cTable=
+      []()
+      {
+	/// Result
+	std::array<uint32_t,256> res{};
+	
+	for(uint32_t i=0;i<256;i++)
+	  {
+	    uint32_t c=i;
+	    for(int k=0;k<8;k++)
+	      c=(c>>1)^((c&1)?CRC32C_POLY:0);
+	    
+	    res[i]=c;
+	  }
+	
+	return res;
+      }();
+  }
+  
+  /// Computes the CRC-32C of size bytes of data, continuing from crc
+  inline uint32_t crc32c(const void* data,
+			 const int64_t& size,
+			 const uint32_t& crc=0)
+  {
+    /// Bytes to be processed
+    const char* p=
+      (const char*)data;
+    
+    /// End of the data
+    const char* end=
+      p+size;
+    
+    /// Running value, kept inverted
+    uint32_t c=
+      ~crc;
+    
+#ifdef __SSE4_2__
+    /// Running value in 64 bits, as used by the instruction
+    uint64_t c64=
+      c;
+    
+    for(;p+8<=end;p+=8)
+      {
+	/// Word to be processed, possibly unaligned
+	uint64_t w;
+	memcpy(&w,p,8);
+	
+	c64=_mm_crc32_u64(c64,w);
+      }
+    
+    c=c64;
+    
+    for(;p<end;p++)
+      c=_mm_crc32_u8(c,*p);
+#else
+    for(;p<end;p++)
+      c=(c>>8)^resources::crc32cTable[(c^(uint8_t)*p)&0xFF];
+#endif
+    
+    return ~c;
+  }
+}
+
+#endif
@@ -7,8 +7,13 @@
 
 /// \file math.hpp
 
+#include <cstdint>
 #include <utility>
 
+#ifdef __BMI2__
+# include <immintrin.h>
+#endif
+
 namespace maze
 {
   // Return the log2 of N
@@ -24,6 +29,35 @@ namespace maze
     return log2N;
   }
   
+  /// Returns whether n is a power of 2
+  template <typename I>
+  constexpr bool isPowerOf2(const I& n)
+  {
+    return n>0 and (n&(n-1))==0;
+  }
+  
+  /// Gathers the bits of x selected by mask into the lowest bits of the result
+  inline uint64_t extractBits(const uint64_t& x,
+			      uint64_t mask)
+  {
+#ifdef __BMI2__
+    return _pext_u64(x,mask);
+#else
+    /// Result
+    uint64_t res=0;
+    
+    for(uint64_t bit=1;mask;bit<<=1)
+      {
+	if(x&mask&-mask)
+	  res|=bit;
+	
+	mask&=mask-1;
+      }
+    
+    return res;
+#endif
+  }
+  
   /// Adds an offset to an index sequence
   template <std::size_t O,
 	    std::size_t...Is>
@@ -102,7 +102,7 @@ namespace maze
       {
 	/// Predicate result, counting whether the type match
 	static constexpr bool value=
-	  ((std::is_same<T,Fs>::value+...)==0);
+	  ((0+...+std::is_same<T,Fs>::value)==0);
       };
       
       /// Returned type
@@ -138,7 +138,7 @@ namespace maze
       {
 	/// Predicate result
 	static constexpr bool value=
-	  ((std::is_same<T,Tp>::value+...)==N);
+	  ((0+...+std::is_same<T,Tp>::value)==N);
       };
     };
   }
@@ -189,6 +189,31 @@ namespace maze
     return
       res;
   }
+  
+  namespace impl
+  {
+    /// Extracts from a tuple the elements of the given types
+    ///
+    /// Internal implementation
+    template <typename...R,
+	      typename...T>
+    std::tuple<R...> _tupleGetSubset(std::tuple<R...>*,
+				     const std::tuple<T...>& t)
+    {
+      return
+	{std::get<R>(t)...};
+    }
+  }
+  
+  /// Extracts from the tuple the elements of the types listed in ResTuple
+  template <typename ResTuple,     ///< Tuple type to be returned, to be provided
+	    typename...T>          ///< Types of the tuple to be searched
+  ResTuple tupleGetSubset(const std::tuple<T...>& t) ///< Tuple to be searched
+  {
+    return
+      impl::_tupleGetSubset((ResTuple*)nullptr,t);
+  }
+  
   namespace impl
   {
     template <typename I,